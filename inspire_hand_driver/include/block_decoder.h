@@ -0,0 +1,57 @@
+/*********************************************************************************************//**
+* block_decoder.h
+*
+* Batch decoder for the 6 x 16 bit little endian register blocks of captured
+* read responses (POS_ACT, ANGLE_ACT, FORCE_ACT, CURRENT, ...). Blocks sit at
+* a fixed stride in one buffer, typically whole frames back to back; the
+* decoder transposes them into one float array per DOF, sign extending for
+* signed registers such as FORCE_ACT.
+*
+* On x86 the blocks go through SSE2, four at a time, or AVX2, eight at a time,
+* when the CPU has it; elsewhere, and for the last few blocks, a scalar loop
+* does the same. All paths give identical results, test_block_decoder and
+* hand_capture_decode --self-test check that.
+*
+* *********************************************************************************************/
+
+#ifndef BLOCK_DECODER_H
+#define BLOCK_DECODER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace inspire_hand
+{
+
+class block_decoder
+{
+public:
+
+    static const int DOF = 6;
+    //Data bytes of one block
+    static const size_t BLOCK_BYTES = DOF * 2;
+
+    enum path
+    {
+        PATH_SCALAR,
+        PATH_SSE2,
+        PATH_AVX2
+    };
+
+    /** \brief Best path this build and CPU support */
+    static path bestPath();
+    static const char *pathName(path p);
+
+    /** \brief Decode count blocks, block k starting at data + k * stride (stride >= BLOCK_BYTES), into
+     *  out[dof][k]. Values are taken as int16 when is_signed, as uint16 otherwise.
+     *  Never reads past the last block */
+    static void decode(const uint8_t *data, size_t stride, size_t count, bool is_signed, float *const out[DOF],
+                       path p = bestPath());
+
+    /** \brief Reference implementation, one value at a time */
+    static void decodeScalar(const uint8_t *data, size_t stride, size_t first, size_t count, bool is_signed,
+                             float *const out[DOF]);
+};
+}
+
+#endif
@@ -0,0 +1,90 @@
+/*********************************************************************************************//**
+* bus_scheduler.h
+*
+* Priority lock for the serial bus. Callers queue per class and the bus goes to
+* the highest class waiting: real-time commands, then safety reads, then
+* best-effort telemetry. A waiter queued longer than its class's max wait is
+* served next regardless of class, so safety reads keep a minimum share of the
+* bus under a steady command stream. The queueing delay of every grant is kept
+* per class.
+*
+* *********************************************************************************************/
+
+#ifndef BUS_SCHEDULER_H
+#define BUS_SCHEDULER_H
+
+#include <latency_histogram.h>
+
+#include <stdint.h>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+namespace inspire_hand
+{
+
+enum bus_class
+{
+    BUS_COMMAND = 0,
+    BUS_SAFETY = 1,
+    BUS_TELEMETRY = 2,
+    BUS_CLASS_COUNT
+};
+
+class bus_scheduler
+{
+public:
+
+    bus_scheduler();
+
+    /** \brief Wait (us) after which a waiter of cls goes ahead of higher classes, 0 never */
+    void setMaxWait(int cls, uint64_t max_wait_us);
+
+    /** \brief Block until cls owns the bus, returns the queueing delay (us) */
+    uint64_t acquire(int cls);
+    void release();
+
+    /** \brief Queueing delay of the grants of cls so far (us), and how many of them jumped the queue */
+    void stats(int cls, latency_histogram &delay, uint32_t &promoted) const;
+
+private:
+
+    struct ticket
+    {
+        uint64_t seq;
+        uint64_t since_us;
+    };
+
+    //Pick the next owner and wake it, called with mutex_ held and the bus free
+    void grantNext();
+    static uint64_t nowUs();
+
+    mutable std::mutex mutex_;
+    std::condition_variable granted_cv_;
+    std::deque<ticket> waiting_[BUS_CLASS_COUNT];
+    bool busy_;
+    uint64_t next_seq_;
+    uint64_t granted_;
+    uint64_t max_wait_[BUS_CLASS_COUNT];
+    latency_histogram delay_[BUS_CLASS_COUNT];
+    uint32_t promoted_[BUS_CLASS_COUNT];
+};
+
+//Holds the bus for one scope
+class bus_grant
+{
+public:
+
+    bus_grant(bus_scheduler &scheduler, int cls): scheduler_(scheduler) { scheduler_.acquire(cls); }
+    ~bus_grant() { scheduler_.release(); }
+
+private:
+
+    bus_grant(const bus_grant &);
+    bus_grant &operator=(const bus_grant &);
+
+    bus_scheduler &scheduler_;
+};
+}
+
+#endif
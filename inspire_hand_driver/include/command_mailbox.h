@@ -0,0 +1,95 @@
+/*********************************************************************************************//**
+* command_mailbox.h
+*
+* Latest-wins setpoint mailbox. Commands only overwrite the pending target of
+* the DOFs they carry; the driver's command thread takes whatever is pending
+* after each batch of commands, dropping targets whose deadline has already
+* passed.
+*
+* Several producers can share the hand. Each DOF is owned by one source at a
+* time: a source takes a DOF over if its priority is at least the owner's, or
+* once the owner's lease has run out. Commands for DOFs held by a higher
+* priority source are rejected.
+*
+* Not synchronized, the owner serializes post() and take().
+*
+* *********************************************************************************************/
+
+#ifndef COMMAND_MAILBOX_H
+#define COMMAND_MAILBOX_H
+
+#include <stdint.h>
+
+namespace inspire_hand
+{
+
+//Setpoint registers a command can carry
+enum setpoint_field
+{
+    SP_ANGLE = 0,
+    SP_FORCE = 1,
+    SP_SPEED = 2,
+    SP_FIELD_COUNT
+};
+
+/** \brief Targets taken from the mailbox, -1 where nothing is pending */
+struct setpoint_targets
+{
+    int value[SP_FIELD_COUNT][6];
+    //Stamp of the oldest target taken, 0 if none
+    uint64_t oldest_stamp_ns;
+
+    void clear();
+    bool any(int field) const;
+};
+
+class command_mailbox
+{
+public:
+
+    command_mailbox();
+
+    /** \brief Post one command; value[field] may be NULL, -1 entries leave that target untouched.
+     *  Every accepted DOF is (re)claimed for source until lease_until_ns. Returns the mask of accepted DOFs */
+    uint8_t post(uint8_t source, uint8_t priority, uint8_t dof_mask, const int16_t *const value[SP_FIELD_COUNT],
+                 uint64_t stamp_ns, uint64_t deadline_ns, uint64_t now_ns, uint64_t lease_until_ns);
+
+    /** \brief Take all pending targets still inside their deadline, returns false if nothing is left */
+    bool take(uint64_t now_ns, setpoint_targets &out);
+
+    bool pending() const;
+
+    //Counters since construction
+    uint32_t received() const { return received_; }
+    uint32_t coalesced() const { return coalesced_; }
+    uint32_t expired() const { return expired_; }
+    uint32_t rejected() const { return rejected_; }
+
+private:
+
+    struct slot
+    {
+        bool pending;
+        int value;
+        uint64_t stamp_ns;
+        uint64_t deadline_ns;
+    };
+
+    struct owner
+    {
+        bool owned;
+        uint8_t source;
+        uint8_t priority;
+        uint64_t lease_until_ns;
+    };
+
+    slot slot_[SP_FIELD_COUNT][6];
+    owner owner_[6];
+    uint32_t received_;
+    uint32_t coalesced_;
+    uint32_t expired_;
+    uint32_t rejected_;
+};
+}
+
+#endif
@@ -0,0 +1,135 @@
+/*********************************************************************************************//**
+* command_shm.h
+*
+* Shared-memory command ingress for producers on the same host. The driver
+* creates a ring of timestamped 6-DOF targets, one local producer appends to
+* it and the driver's command thread drains it once per poll period into the
+* command mailbox, next to the HandCommand topic. The segment is created fresh, mode
+* 0600 or 0660 for one producer group, since writing it moves the hand.
+*
+* Every entry carries a sequence number (1, 2, ...). The slot's own copy of the
+* number is cleared while the producer rewrites it, so the consumer can tell a
+* complete entry from one being overwritten; a gap in the numbers means the
+* producer lapped the consumer. The consumer publishes the last number it took,
+* so a producer can see whether its targets are still being picked up.
+*
+* Link against inspire_hand_shm.
+*
+* *********************************************************************************************/
+
+#ifndef COMMAND_SHM_H
+#define COMMAND_SHM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <atomic>
+
+namespace inspire_hand
+{
+
+/** \brief One command, same fields as HandCommand */
+struct shm_command
+{
+    uint64_t seq;           //set by the writer
+    uint64_t stamp_ns;      //wall clock, ns since epoch; 0 stamps with the arrival time
+    uint8_t dof_mask;
+    uint8_t source;
+    uint8_t priority;
+    uint8_t reserved;
+    int16_t angle[6];       //-1 leaves the register unchanged
+    int16_t speed[6];
+    int16_t force[6];
+};
+
+/** \brief Layout of the segment */
+struct shm_command_ring
+{
+    static const uint32_t CAPACITY = 64;
+
+    struct slot
+    {
+        std::atomic<uint64_t> seq;  //0 while being written
+        shm_command command;
+    };
+
+    char magic[4];                  //"IHCR"
+    uint16_t version;
+    uint16_t entry_size;
+    uint32_t capacity;
+    std::atomic<uint32_t> alive;    //1 while the driver has the segment open
+    std::atomic<uint64_t> head;     //last sequence number written
+    std::atomic<uint64_t> consumed; //last sequence number the driver took
+    slot slots[CAPACITY];
+};
+
+/** \brief Driver side: owns the segment and drains it */
+class command_shm_reader
+{
+public:
+
+    static const uint16_t VERSION = 1;
+
+    command_shm_reader();
+
+    ~command_shm_reader();
+
+    /** \brief Create the segment, name as for shm_open ("/inspire_hand_1_cmd"), replacing a stale one.
+     *  Mode 0600, or 0660 owned by group when group >= 0 so producers of that group can write it */
+    bool open(const std::string &name, int group = -1);
+
+    void close();
+
+    bool isOpen() const { return ring_ != NULL; }
+
+    /** \brief Append the entries written since the last call, oldest first. Returns the number taken */
+    size_t take(std::vector<shm_command> &out);
+
+    //Counters since open
+    uint64_t taken() const { return taken_; }
+    //Entries overwritten before they were taken, or caught mid-write
+    uint64_t lost() const { return lost_; }
+
+private:
+
+    std::string name_;
+    shm_command_ring *ring_;
+    uint64_t last_;
+    uint64_t taken_;
+    uint64_t lost_;
+};
+
+/** \brief Producer side, one writer per segment */
+class command_shm_writer
+{
+public:
+
+    command_shm_writer();
+
+    ~command_shm_writer();
+
+    /** \brief Map the segment the driver created, false if it does not exist or has another layout */
+    bool open(const std::string &name);
+
+    void close();
+
+    bool isOpen() const { return ring_ != NULL; }
+
+    /** \brief Append one command, never blocks. Returns its sequence number */
+    uint64_t post(const shm_command &command);
+
+    /** \brief Last sequence number the driver took; falling behind post() means targets go stale */
+    uint64_t consumed() const;
+
+    /** \brief False once the driver closed the segment */
+    bool readerAlive() const;
+
+private:
+
+    shm_command_ring *ring_;
+    uint64_t next_;
+};
+}
+
+#endif
@@ -0,0 +1,43 @@
+/*********************************************************************************************//**
+* contact_detector.h
+*
+* Per-finger contact onset/release detection on the FORCE_ACT stream with
+* onset/release thresholds (hysteresis).
+*
+* *********************************************************************************************/
+
+#ifndef CONTACT_DETECTOR_H
+#define CONTACT_DETECTOR_H
+
+#include <stdint.h>
+
+namespace inspire_hand
+{
+
+class contact_detector
+{
+public:
+
+    static const int DOF = 6;
+
+    contact_detector();
+
+    //设置某个自由度的接触/释放阈值 (release <= onset)
+    void setThreshold(int dof, float onset, float release);
+
+    /** \brief Feed one FORCE_ACT sample, returns a bit mask of the DOFs whose contact state changed */
+    uint8_t update(const float *force);
+
+    bool inContact(int dof) const { return contact_[dof]; }
+
+    void reset();
+
+private:
+
+    float onset_[DOF];
+    float release_[DOF];
+    bool contact_[DOF];
+};
+}
+
+#endif
@@ -0,0 +1,185 @@
+/*********************************************************************************************//**
+* dataset_exporter.h
+*
+* Columnar, time-aligned export of commanded angle, actual angle, force,
+* current and temperature. One file per hand, written in chunks; inside a
+* chunk every (channel, DOF) column and the timestamp column are contiguous
+* arrays. A chunk index at the end of the file lets dataset_reader map a
+* multi-hour session and slice a time window without parsing it.
+*
+* File layout (little endian):
+*   dataset_file_header
+*   chunk*:  dataset_chunk_header, uint64 stamp_ns[rows],
+*            int16 column[channel][dof][rows], zero padding to 8 bytes
+*   dataset_index_entry[chunk_count]
+*   dataset_footer
+*
+* *********************************************************************************************/
+
+#ifndef DATASET_EXPORTER_H
+#define DATASET_EXPORTER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace inspire_hand
+{
+
+//Channels of a dataset row, each one has six DOF columns
+enum dataset_channel
+{
+    DS_ANGLE_CMD = 0,
+    DS_ANGLE_ACT = 1,
+    DS_FORCE_ACT = 2,
+    DS_CURRENT = 3,
+    DS_TEMP = 4,
+    DS_CHANNEL_COUNT
+};
+
+const char *dataset_channel_name(int channel);
+
+static const int DS_DOF = 6;
+
+#pragma pack(push, 1)
+struct dataset_file_header
+{
+    char magic[4];          //"IHDS"
+    uint16_t version;
+    uint16_t dof;
+    uint16_t channels;
+    uint16_t reserved;
+    uint32_t hand_id;
+    uint32_t chunk_rows;
+    uint32_t reserved2;     //keeps chunks 8 byte aligned
+};
+
+struct dataset_chunk_header
+{
+    char magic[4];          //"CHNK"
+    uint32_t rows;
+    uint64_t t_first;
+    uint64_t t_last;
+};
+
+struct dataset_index_entry
+{
+    uint64_t offset;        //of the dataset_chunk_header
+    uint32_t rows;
+    uint32_t reserved;
+    uint64_t t_first;
+    uint64_t t_last;
+};
+
+struct dataset_footer
+{
+    uint64_t index_offset;
+    uint32_t chunk_count;
+    char magic[4];          //"IDX1"
+};
+#pragma pack(pop)
+
+class dataset_writer
+{
+public:
+
+    static const uint16_t VERSION = 1;
+
+    dataset_writer();
+
+    ~dataset_writer();
+
+    bool open(const std::string &path, int hand_id, uint32_t chunk_rows = 1024);
+
+    /** \brief Write the partial chunk, the chunk index and the footer */
+    void close();
+
+    bool isOpen() const { return file_ != NULL; }
+
+    /** \brief Append one row, value[channel][dof]. Full chunks are written by a background thread */
+    void append(uint64_t stamp_ns, const float value[DS_CHANNEL_COUNT][DS_DOF]);
+
+    uint64_t rows() const { return rows_; }
+
+private:
+
+    struct chunk
+    {
+        uint32_t rows;
+        std::vector<uint64_t> stamp;
+        std::vector<int16_t> column;    //[channel * DOF + dof][chunk_rows]
+    };
+
+    void writerLoop();
+
+    void writeChunk(const chunk &c);
+
+    FILE *file_;
+    uint32_t chunk_rows_;
+    uint64_t rows_;
+    chunk current_;
+
+    //Handoff of full chunks to the writer thread
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<chunk> pending_;
+    bool stop_;
+    std::thread writer_;
+
+    //Only touched by the writer thread until close() joins it
+    std::vector<dataset_index_entry> index_;
+};
+
+/** \brief Copy of a time window, one contiguous vector per column */
+struct dataset_slice
+{
+    std::vector<uint64_t> stamp;
+    std::vector<int16_t> column[DS_CHANNEL_COUNT][DS_DOF];
+};
+
+class dataset_reader
+{
+public:
+
+    dataset_reader();
+
+    ~dataset_reader();
+
+    /** \brief Map a dataset file; falls back to scanning chunk headers if the writer never wrote the index */
+    bool open(const std::string &path);
+
+    void close();
+
+    const dataset_file_header &header() const { return header_; }
+
+    size_t chunkCount() const { return index_.size(); }
+
+    const dataset_index_entry &chunkInfo(size_t i) const { return index_[i]; }
+
+    uint64_t rows() const;
+
+    //Zero-copy access into the mapped file
+    const uint64_t *chunkStamps(size_t i) const;
+
+    const int16_t *chunkColumn(size_t i, int channel, int dof) const;
+
+    /** \brief Copy rows with t0 <= stamp < t1, only chunks overlapping the window are touched */
+    size_t slice(uint64_t t0, uint64_t t1, dataset_slice &out) const;
+
+private:
+
+    bool scanChunks();
+
+    const uint8_t *data_;
+    size_t size_;
+    dataset_file_header header_;
+    std::vector<dataset_index_entry> index_;
+};
+}
+
+#endif
@@ -0,0 +1,76 @@
+/*********************************************************************************************//**
+* frame_parser.h
+*
+* Incremental parser for hand responses. Received bytes go into a ring buffer;
+* the parser looks for the response header, checks length and checksum, skips
+* garbage until the next valid header and hands out complete frames, no matter
+* how the bytes were split or concatenated by the serial reads.
+*
+* Response frame: 90 EB id len cmd addrL addrH data... checksum
+* (checksum = sum of id..last data byte, low 8 bits; len counts cmd, addr and data)
+*
+* *********************************************************************************************/
+
+#ifndef FRAME_PARSER_H
+#define FRAME_PARSER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace inspire_hand
+{
+
+class frame_parser
+{
+public:
+
+    //Longest frame the length byte allows
+    static const size_t MAX_FRAME = 255 + 5;
+    //Power of two, holds a few pipelined responses
+    static const size_t RING_SIZE = 1024;
+
+    frame_parser(uint8_t head0 = 0x90, uint8_t head1 = 0xEB);
+
+    /** \brief Append received bytes; when the ring is full the oldest bytes are dropped */
+    void push(const uint8_t *data, size_t size);
+
+    /** \brief Take the next complete, checksum-valid frame (header to checksum), returns false if none is buffered yet */
+    bool next(std::vector<uint8_t> &frame);
+
+    /** \brief Drop everything buffered, counters are kept */
+    void reset();
+
+    size_t buffered() const { return tail_ - head_; }
+
+    //Counters since construction
+    uint32_t frames() const { return frames_; }
+    uint32_t checksumErrors() const { return checksum_errors_; }
+    //Times the parser had to skip bytes to find the next header
+    uint32_t resyncs() const { return resyncs_; }
+    uint32_t skippedBytes() const { return skipped_bytes_; }
+    uint32_t overflows() const { return overflows_; }
+
+private:
+
+    uint8_t at(size_t offset) const { return ring_[(head_ + offset) & (RING_SIZE - 1)]; }
+    void skip(size_t count);
+
+    uint8_t head0_;
+    uint8_t head1_;
+    uint8_t ring_[RING_SIZE];
+    //Free running, only masked on access
+    size_t head_;
+    size_t tail_;
+    //Currently inside a run of skipped bytes, a run counts as one resync
+    bool in_garbage_;
+
+    uint32_t frames_;
+    uint32_t checksum_errors_;
+    uint32_t resyncs_;
+    uint32_t skipped_bytes_;
+    uint32_t overflows_;
+};
+}
+
+#endif
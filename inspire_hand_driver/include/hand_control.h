@@ -33,6 +33,8 @@
 #include <inspire_hand/set_angle.h>
 #include <inspire_hand/set_force.h>
 #include <inspire_hand/set_speed.h>
+#include <inspire_hand/set_setpoint.h>
+#include <inspire_hand/apply_profile.h>
 #include <inspire_hand/get_pos_act.h>
 #include <inspire_hand/get_angle_act.h>
 #include <inspire_hand/get_force_act.h>
@@ -43,11 +45,86 @@
 #include <inspire_hand/get_pos_set.h>
 #include <inspire_hand/get_angle_set.h>
 #include <inspire_hand/get_force_set.h>
+#include <inspire_hand/query_history.h>
+
+//Message headers
+#include <inspire_hand/ContactEvent.h>
+#include <inspire_hand/HandState.h>
+#include <inspire_hand/HandCommand.h>
+#include <inspire_hand/CommandStats.h>
+#include <inspire_hand/HandHealth.h>
+#include <inspire_hand/BusStats.h>
+#include <inspire_hand/HandThermal.h>
+#include <inspire_hand/HandMaintenanceAction.h>
+#include <actionlib/server/simple_action_server.h>
+#include <ros/callback_queue.h>
+
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <map>
+
+#include <contact_detector.h>
+#include <state_logger.h>
+#include <dataset_exporter.h>
+#include <command_mailbox.h>
+#include <frame_parser.h>
+#include <latency_histogram.h>
+#include <bus_scheduler.h>
+#include <thermal_model.h>
+#include <state_shm.h>
+#include <command_shm.h>
+#include <register_map.h>
+#include <state_history.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
 
 
 namespace inspire_hand
 {
 
+//Outcome of one request/response exchange with the hand
+enum transaction_result
+{
+    TR_OK = 0,
+    //Nothing came back before the deadline, on every attempt
+    TR_TIMEOUT,
+    //A response started but was cut off at the deadline
+    TR_SHORT_FRAME,
+    //Bytes came back, but no frame with a valid checksum answered the request
+    TR_CORRUPT
+};
+
+//Bus counters since start, guarded by the bus mutex
+struct bus_counters
+{
+    uint32_t transactions;
+    uint32_t retries;
+    //Transactions that failed after all attempts: nothing received, a checksum failure, or a partial answer
+    uint32_t timeouts;
+    uint32_t corrupt;
+    uint32_t short_frames;
+    //Valid frames that answered no pending request
+    uint32_t unmatched;
+    //Register address -> transactions that failed on it
+    std::map<uint16_t, uint32_t> register_errors;
+    //Seconds the bus was held, retries and backoff included
+    double busy_time;
+
+    bus_counters(): transactions(0), retries(0), timeouts(0), corrupt(0), short_frames(0), unmatched(0), busy_time(0) {}
+};
+
+//Maintenance commands, same values as HandMaintenanceGoal
+enum maintenance_op
+{
+    MAINT_CLEAR_ERROR = 0,
+    MAINT_SAVE_FLASH = 1,
+    MAINT_RESET_PARA = 2,
+    MAINT_FORCE_CLB = 3
+};
+
+//Called on every completion poll with the elapsed time and the STATUS and ERROR bytes, return false to stop waiting
+typedef boost::function<bool(double elapsed, const uint8_t *status, const uint8_t *error)> maintenance_progress;
+
 class hand_serial
 {
 public:
@@ -55,6 +132,9 @@ public:
     hand_serial(ros::NodeHandle *nh);
 
     ~hand_serial();
+
+    //发布服务、话题并启动状态轮询 (节点与nodelet共用)
+    void advertise(ros::NodeHandle *nh);
     //设置函数的callback
     bool setIDCallback(inspire_hand::set_id::Request &req,
                        inspire_hand::set_id::Response &res);
@@ -101,6 +181,12 @@ public:
     bool setSPEEDCallback(inspire_hand::set_speed::Request &req,
                           inspire_hand::set_speed::Response &res);
 
+    bool setSETPOINTCallback(inspire_hand::set_setpoint::Request &req,
+                             inspire_hand::set_setpoint::Response &res);
+
+    bool applyPROFILECallback(inspire_hand::apply_profile::Request &req,
+                              inspire_hand::apply_profile::Response &res);
+
     bool getPOS_ACTCallback(inspire_hand::get_pos_act::Request &req,
                             inspire_hand::get_pos_act::Response &res);
 
@@ -131,17 +217,265 @@ public:
     bool getFORCE_SETCallback(inspire_hand::get_force_set::Request &req,
                               inspire_hand::get_force_set::Response &res);
 
+    //历史窗口统计查询 (min/max/mean/RMS/百分位), 只读内存中的历史, 不访问总线
+    bool queryHistoryCallback(inspire_hand::query_history::Request &req,
+                              inspire_hand::query_history::Response &res);
+
     //void timerCallback(const ros::TimerEvent &event);
 
+    //设定值命令回调 (inspire_hand/command), 只保存每个自由度的最新目标
+    void commandCallback(const inspire_hand::HandCommand::ConstPtr &cmd);
+
+    //共享内存命令检查 (command_shm_name), 与轮询同频率, 在命令线程中运行
+    void shmCommandCallback(const ros::TimerEvent &event);
+
+    //命令统计发布回调
+    void statsTimerCallback(const ros::TimerEvent &event);
+
+    /** \brief Publish the latency histograms on diagnostics and rewrite the metrics file */
+    void metricsTimerCallback(const ros::TimerEvent &event);
+
+    //状态轮询周期回调: 读取FORCE_ACT并发布接触事件
+    void pollTimerCallback(const ros::TimerEvent &event);
+
+    //轮询周期(s), poll_rate <= 0 时不轮询
+    double pollPeriod() const { return poll_rate_ > 0 ? 1.0 / poll_rate_ : 0.0; }
+
     //关节参数发布
     //ros::Publisher joint_pub;
 
+    //接触事件发布
+    ros::Publisher contact_pub;
+
+    //灵巧手状态发布
+    ros::Publisher state_pub;
+
+    //命令统计发布
+    ros::Publisher command_stats_pub;
+
+    //总线统计发布
+    ros::Publisher bus_stats_pub;
+
+    //热模型与限速发布
+    ros::Publisher thermal_pub;
+
+    //延迟直方图发布 (diagnostics)
+    ros::Publisher diagnostics_pub;
+
+    //启动状态发布 (latched)
+    ros::Publisher health_pub;
+
     //TF更新周期
     //static const float TF_UPDATE_PERIOD = 0.5;
 
 
 private:
 
+    /** \brief Advertise a service that is refused until bring-up has finished */
+    template <class MReq, class MRes>
+    void advertiseGated(ros::NodeHandle *nh, const std::string &name, bool (hand_serial::*callback)(MReq &, MRes &))
+    {
+        services_.push_back(nh->advertiseService<MReq, MRes>(name,
+                            boost::bind(&hand_serial::gatedCall<MReq, MRes>, this, name, callback, _1, _2)));
+    }
+
+    template <class MReq, class MRes>
+    bool gatedCall(const std::string &name, bool (hand_serial::*callback)(MReq &, MRes &), MReq &req, MRes &res)
+    {
+        ros::WallTime start = ros::WallTime::now();
+        bool ok = false;
+        if (ready_)
+            ok = (this->*callback)(req, res);
+        else
+            ROS_WARN("Hand: not ready, request refused");
+        recordService(name, (ros::WallTime::now() - start).toSec(), ok);
+        return ok;
+    }
+
+    /** \brief Id scan, first state read, profile and output files; runs on bringup_thread_ */
+    void bringUp();
+
+    //Startup phase timing, reported on inspire_hand/health
+    void beginPhase(const std::string &phase);
+    void endPhase();
+    void failPhase(const std::string &detail);
+    void publishHealth();
+
+    /** \brief Append the checksum, send one frame and wait for the response. All register access goes through here.
+     *  Every attempt is bounded by response_timeout, failed ones are retried with a doubling backoff */
+    transaction_result transaction(serial::Serial *port, std::vector<uint8_t> &output, std::vector<uint8_t> &input, double wait);
+
+    /** \brief One attempt: write all requests, then parse frames until each request has its answer or the
+     *  deadline, the larger of wait and response_timeout after the write, passes. Caller holds the bus */
+    transaction_result exchange(serial::Serial *port, const std::vector<std::vector<uint8_t> > &requests,
+                                std::vector<std::vector<uint8_t> > &responses, double wait);
+
+    //Key of the pipelined write batch in register_metrics_
+    static const uint32_t OP_BATCH = 0xff0000;
+
+    //Latency/outcome bookkeeping per register operation (cmd << 16 | address) and per service
+    void recordTransaction(uint32_t key, double seconds, transaction_result result, int retries);
+    /** \brief Count a failed transaction in bus_stats_ by its result, bus mutex held*/
+    void countFailure(transaction_result result);
+    void recordService(const std::string &name, double seconds, bool ok);
+    static std::string operationName(uint32_t key);
+
+    /** \brief Whether a parsed frame is the answer to a request */
+    static bool answers(const std::vector<uint8_t> &request, const std::vector<uint8_t> &response);
+
+    /** \brief Send several write frames back to back and collect all acks after a single wait. acked holds the result of each frame, returns false if any was not acknowledged */
+    bool transactionBatch(serial::Serial *port, std::vector<std::vector<uint8_t> > &frames, double wait, std::vector<bool> &acked);
+
+    /** \brief Add the checksum over id..data to the end of a frame */
+    static void appendChecksum(std::vector<uint8_t> &output);
+
+    /** \brief Register write frame without checksum, values are sent little endian with width bytes each */
+    std::vector<uint8_t> writeFrame(uint16_t addr, const int *value, int count, int width = 2);
+
+    /** \brief Register read frame for bytes bytes from addr, without checksum */
+    std::vector<uint8_t> readFrame(uint16_t addr, int bytes);
+
+    /** \brief Hex dump of a frame for test_flags output */
+    static std::string hexString(const std::vector<uint8_t> &data);
+
+    /** \brief Append the frames for the dirty registers of one register block, runs separated by a short gap are written as one frame */
+    void appendDirtyFrames(std::vector<std::vector<uint8_t> > &frames, std::vector<std::pair<int, int> > &spans,
+                           uint16_t addr, const int *value, const bool *dirty, int count, const int *fill = NULL);
+
+    /** \brief Read count raw bytes starting at addr */
+    transaction_result readBytes(serial::Serial *port, uint16_t addr, int count, uint8_t *value);
+
+    /** \brief Read elements first..first+count-1 of register R, decoded with its width and sign.
+     *  count * R::width must fit in one frame */
+    template <class R>
+    transaction_result readRegister(serial::Serial *port, int *value, int first = 0, int count = R::count)
+    {
+        static_assert(R::access & REG_R, "register is not readable");
+        uint8_t data[MAX_FRAME_DATA];
+        transaction_result result = readBytes(port, R::addr + first * R::width, count * R::width, data);
+        if (result != TR_OK)
+            return result;
+        for (int i = 0; i < count; i++)
+            value[i] = R::decode(data, i);
+        return TR_OK;
+    }
+
+    /** \brief Read a register_block in one frame, decode with B::decode<R>() */
+    template <class B>
+    transaction_result readBlock(serial::Serial *port, uint8_t *data)
+    {
+        return readBytes(port, B::addr, B::bytes, data);
+    }
+
+    /** \brief Write elements first..first+count-1 of register R. Values outside its range are refused
+     *  without touching the bus; returns true if the hand acknowledged */
+    template <class R>
+    bool writeRegister(serial::Serial *port, const int *value, int first = 0, int count = R::count)
+    {
+        static_assert(R::access & REG_W, "register is not writable");
+        if (!checkRange<R>(value, count))
+            return false;
+        std::vector<uint8_t> output = writeFrame(R::addr + first * R::width, value, count, R::width);
+        std::vector<uint8_t> input;
+        if (transaction(port, output, input, 0.015) != TR_OK)
+            return false;
+        return input[7] == 1;
+    }
+
+    template <class R>
+    static bool checkRange(const int *value, int count)
+    {
+        for (int i = 0; i < count; i++)
+            if (!R::valid(value[i]))
+            {
+                ROS_WARN("Hand: %s value %d outside %d..%d, not written", R::name(), value[i], int(R::min), int(R::max));
+                return false;
+            }
+        return true;
+    }
+
+    /** \brief One ANGLE_SET/FORCE_SET/SPEED_SET target (field SP_*) against its register range, -1 keeps the target*/
+    static bool checkSetpoint(int field, int value)
+    {
+        switch (field)
+        {
+        case SP_ANGLE: return checkRange<reg::ANGLE_SET>(&value, 1);
+        case SP_FORCE: return checkRange<reg::FORCE_SET>(&value, 1);
+        default: return checkRange<reg::SPEED_SET>(&value, 1);
+        }
+    }
+
+    /** \brief Poll until the trigger register of a maintenance command has cleared (and, for CLEAR_ERROR, no error is left) */
+    bool waitMaintenance(serial::Serial *port, int operation, const maintenance_progress &progress);
+
+    /** \brief Action server thread: runs one maintenance command while the poll loop keeps using the bus between polls */
+    void maintenanceExecute(const inspire_hand::HandMaintenanceGoalConstPtr &goal);
+
+    //Configuration profile, loaded from inspire_hand/profiles/<name>
+    struct config_profile
+    {
+        //CURRENT_LIMIT, DEFAULT_SPEED and DEFAULT_FORCE (0x03FC-0x041F), -1 where the profile leaves the value alone
+        int defaults[18];
+        //User gesture number (14-45) -> six angles
+        std::map<int, std::vector<int> > user_angles;
+    };
+
+    /** \brief Read a profile from the parameter server */
+    bool loadProfile(const std::string &name, config_profile &profile);
+
+    /** \brief Write the registers that differ from the profile in one batch, then save to flash if asked and anything changed */
+    bool applyProfile(serial::Serial *port, const config_profile &profile, bool save, int &written, bool &saved);
+
+    /** \brief Record acknowledged setpoint writes in the shadow, -1 values are skipped */
+    void updateShadow(int field, const int *value, bool acked);
+
+    /** \brief Forget the shadow of fields the hand may have changed on its own (gesture, position write, reset) */
+    void invalidateShadow(int field);
+
+    //Cached readings copied out together under state_mutex_
+    struct state_snapshot
+    {
+        float angle[6];
+        float force[6];
+        float current[6];
+        float status[6];
+        float error[6];
+        float temp[6];
+    };
+    /** \brief Store one register read into a cached state array under state_mutex_*/
+    void storeState(float *state, const int *value);
+    /** \brief Copy all cached readings under state_mutex_*/
+    void snapshotState(state_snapshot &out);
+
+    //Track poll cycles without an answer for the health topic
+    void pollFailed();
+    void pollSucceeded();
+    /** \brief Decides moving vs idle from this cycle's reads and switches the poll period*/
+    void updatePollRate(bool status_read, bool angle_read, const state_snapshot &state);
+    void setPollActive(bool active);
+    /** \brief True for a write frame to a register that moves the hand*/
+    static bool isMotionWrite(const std::vector<uint8_t> &frame);
+    /** \brief Scheduling class of a request frame: motion writes, ERROR/STATUS/TEMP reads and CLEAR_ERROR, the rest*/
+    static int busClassOf(const std::vector<uint8_t> &frame);
+    /** \brief Serves the poll loop and the stats timer, apart from the service callbacks*/
+    void ioLoop();
+    /** \brief Serves the command topic and ring, and writes what they left in the mailbox after each batch*/
+    void commandLoop();
+    /** \brief Read ERROR and TEMP when their minimum rate is due, returns the HandState bits read*/
+    uint8_t safetyReads();
+    /** \brief Advance the thermal model on a fresh TEMP reading and rewrite SPEED_SET when a scale changed.
+     *  Returns the HandState bits read (CURRENT)*/
+    uint8_t thermalUpdate(uint8_t safety_read);
+    /** \brief Remember requested speeds (-1 keeps the last one) and replace them by what the throttle allows*/
+    void scaleSpeeds(int *speeds);
+
+    /** \brief Post one command from the topic or the shared-memory ring to the mailbox */
+    void postCommand(uint8_t source, uint8_t priority, uint8_t dof_mask, const int16_t *angle,
+                     const int16_t *force, const int16_t *speed, const ros::Time &stamp);
+
+    /** \brief Write the pending command targets, called from the command thread */
+    void applyCommands();
+
     //读取灵巧手六个自由度驱动器实际位置
     int start(serial::Serial *port);
 
@@ -152,16 +486,16 @@ private:
     bool setREDU_RATIO(serial::Serial *port, int redu_ratio);
 
     //灵巧手清除错误
-    bool setCLEAR_ERROR(serial::Serial *port);
+    bool setCLEAR_ERROR(serial::Serial *port, const maintenance_progress &progress = maintenance_progress());
 
     //保存参数到FLASH
-    bool setSAVE_FLASH(serial::Serial *port);
+    bool setSAVE_FLASH(serial::Serial *port, const maintenance_progress &progress = maintenance_progress());
 
     //恢复出厂设置
-    bool setRESET_PARA(serial::Serial *port);
+    bool setRESET_PARA(serial::Serial *port, const maintenance_progress &progress = maintenance_progress());
 
     //力传感器校准
-    bool setFORCE_CLB(serial::Serial *port);
+    bool setFORCE_CLB(serial::Serial *port, const maintenance_progress &progress = maintenance_progress());
 
     //设置灵巧手目标手势序列号
     bool setGESTURE_NO(serial::Serial *port, int gesture_no);
@@ -190,35 +524,38 @@ private:
     //设置灵巧手六个自由度速度
     bool setSPEED(serial::Serial *port, int speed0, int speed1, int speed2, int speed3, int speed4, int speed5);
 
+    //同时设置角度、力控阈值和速度（-1保持不变）
+    bool setSETPOINTS(serial::Serial *port, const setpoint_targets &targets);
+
     //读取灵巧手六个自由度驱动器实际位置
-    void getPOS_ACT(serial::Serial *port);
+    transaction_result getPOS_ACT(serial::Serial *port);
 
     //读取灵巧手六个自由度实际角度
-    void getANGLE_ACT(serial::Serial *port);
+    transaction_result getANGLE_ACT(serial::Serial *port);
 
     //读取灵巧手六个自由度实际受力
-    void getFORCE_ACT(serial::Serial *port);
+    transaction_result getFORCE_ACT(serial::Serial *port);
 
     //读取灵巧手六个自由度驱动器实际电流值
-    void getCURRENT(serial::Serial *port);
+    transaction_result getCURRENT(serial::Serial *port);
 
     //读取灵巧手六个自由度驱动器故障信息
     uint8_t getERROR(serial::Serial *port);
 
     //读取灵巧手六个自由度状态信息
-    void getSTATUS(serial::Serial *port);
+    transaction_result getSTATUS(serial::Serial *port);
 
     //读取灵巧手六个自由度温度
-    void getTEMP(serial::Serial *port);
+    transaction_result getTEMP(serial::Serial *port);
 
     //读取灵巧手六个自由度驱动器设置位置
-    void getPOS_SET(serial::Serial *port);
+    transaction_result getPOS_SET(serial::Serial *port);
 
     //读取灵巧手六个自由度设置角度
-    void getANGLE_SET(serial::Serial *port);
+    transaction_result getANGLE_SET(serial::Serial *port);
 
     //读取灵巧手六个自由度设置力控阈值
-    void getFORCE_SET(serial::Serial *port);
+    transaction_result getFORCE_SET(serial::Serial *port);
 
     /** \brief Set periodic position reading by GET_STATE(0x95) command */
     //void getPeriodicPositionUpdate(serial::Serial *port, float update_frequency);
@@ -237,6 +574,8 @@ private:
     std::string port_name_;
     int baudrate_;
     int test_flags;
+    double poll_rate_;
+    double idle_poll_rate_;
 
     //hand state variables
     float act_position_;
@@ -248,13 +587,143 @@ private:
     float errorvalue_[6];
     float statusvalue_[6];
     float tempvalue_[6];
+    //Guards curangle_ to tempvalue_: service calls on the spinner and the poll loop on io_thread_
+    //both refresh them
+    std::mutex state_mutex_;
     float setpos_[6];
     float setangle_[6];
     float setforce_[6];
+    float cmdangle_[6];
     //sensor_msgs::JointState hand_joint_state_;
 
+    //Interfaces created by advertise(); the subscription and timers are served by io_queue_ and
+    //command_queue_, which have to outlive them
+    ros::CallbackQueue io_queue_;
+    ros::CallbackQueue command_queue_;
+    std::vector<ros::ServiceServer> services_;
+    ros::Subscriber command_sub_;
+    ros::Timer poll_timer_;
+    ros::Timer stats_timer_;
+
+    //Latest-wins command path. command_mutex_ guards the mailbox and the counters below: the command
+    //thread posts and takes, stats are read on io_thread_
+    std::mutex command_mutex_;
+    command_mailbox commands_;
+    double command_timeout_;
+    double command_lease_;
+    uint32_t commands_applied_;
+    //Per-DOF targets refused for a value outside the setpoint range
+    uint32_t commands_out_of_range_;
+    double command_lag_last_;
+    double command_lag_max_;
+
+    //Last acknowledged ANGLE_SET/FORCE_SET/SPEED_SET per DOF, -1 when unknown.
+    //Targets equal to the shadow are not written again.
+    //setpoint_mutex_ also guards cmdangle_ and the two counters below
+    int setpoint_shadow_[SP_FIELD_COUNT][6];
+    std::mutex setpoint_mutex_;
+    uint32_t setpoints_suppressed_;
+    uint64_t setpoint_bytes_;
+
+    //Contact detection on the polled force stream
+    contact_detector contact_;
+
+    //Binary log of polled samples, enabled by the log_file param
+    state_logger logger_;
+
+    //Columnar command/state export, enabled by the dataset_dir param
+    dataset_writer dataset_;
+    int dataset_temp_divider_;
+    unsigned int poll_count_;
+
+    //Latest state for local consumers, enabled by the shm_name param
+    state_shm_writer shm_;
+
+    //Recent polled samples for windowed filters and queries, history_size samples deep.
+    //Written by the poll loop, read from service callbacks
+    state_history history_;
+    std::mutex history_mutex_;
+
+    //Command ring for local producers, enabled by the command_shm_name param
+    command_shm_reader command_shm_;
+    std::vector<shm_command> shm_commands_;
+    ros::Timer shm_command_timer_;
+
+    //Motion-adaptive polling: poll_rate_ while a DOF moves, idle_poll_rate_ once the hand
+    //has been still for idle_after_ seconds. Only touched from the I/O thread
+    bool poll_active_;
+    double idle_after_;
+    double motion_delta_;
+    int status_divider_;
+    ros::WallTime last_motion_;
+    float last_angle_[6];
+    bool last_angle_valid_;
+    uint32_t poll_rate_changes_;
+    double poll_cycles_saved_;
+    //Set by any write that starts a motion, whichever thread sent it
+    std::atomic<bool> motion_hint_;
+
+    //Profiles are looked up at request time so a rosparam load takes effect without a restart
+    ros::NodeHandle param_nh_;
+
+    //Maintenance action, completion is polled instead of a fixed 1 s sleep
+    typedef actionlib::SimpleActionServer<inspire_hand::HandMaintenanceAction> maintenance_server;
+    boost::shared_ptr<maintenance_server> maintenance_server_;
+    double maintenance_timeout_;
+    double maintenance_poll_;
+
+    //Transaction deadline and retry policy, and what it cost so far
+    double response_timeout_;
+    int retries_;
+    double retry_backoff_;
+    bus_counters bus_stats_;
+    frame_parser parser_;
+
+    //Latency histograms, cumulative since start
+    std::mutex metrics_mutex_;
+    std::map<uint32_t, op_metrics> register_metrics_;
+    std::map<std::string, op_metrics> service_metrics_;
+    ros::Timer metrics_timer_;
+    double metrics_period_;
+    std::string metrics_file_;
+    //Poll cycles in a row without a valid answer, the health topic reports DEGRADED past degraded_after_
+    int poll_failures_;
+    int degraded_after_;
+
+    //Bring-up runs in the background, everything that touches the hand waits for ready_
+    std::atomic<bool> ready_;
+    std::atomic<bool> stopping_;
+    std::thread bringup_thread_;
+    std::mutex health_mutex_;
+    inspire_hand::HandHealth health_;
+    ros::WallTime bringup_start_;
+    ros::WallTime phase_start_;
+
+    //Poll loop and stats run on io_thread_, the command topic and ring on command_thread_, so neither
+    //a burst of service calls on the spinner nor a poll cycle's reads hold a command back: all three
+    //meet at bus_scheduler_, where a command goes ahead at the next transaction.
+    //The queues themselves are declared ahead of the handles bound to them
+    std::thread io_thread_;
+    std::thread command_thread_;
+    bus_scheduler bus_scheduler_;
+    //Minimum rate of the ERROR and TEMP reads, whatever the poll rate does
+    double safety_rate_;
+    ros::WallTime last_error_read_;
+    ros::WallTime last_temp_read_;
+
+    //Thermal throttle: SPEED_SET gets the requested speed times the model's scale.
+    //Requests come from services and commands, the model runs on the I/O thread
+    thermal_model thermal_;
+    bool thermal_enabled_;
+    std::mutex thermal_mutex_;
+    int speed_request_[6];
+    ros::WallTime last_thermal_;
+
     //Serial variables
     serial::Serial *com_port_;
+    //Held for a whole request/response exchange, this node is the only owner of the port.
+    //Taken after a grant from bus_scheduler_, alone it only guards the bus counters and the parser
+    std::mutex bus_mutex_;
 
     //Consts
 
@@ -263,8 +732,8 @@ private:
     //static const double MAX_GRIPPER_VEL_LIMIT = 83;
     //static const double MIN_GRIPPER_ACC_LIMIT = 0;
     //static const double MAX_GRIPPER_ACC_LIMIT = 320;
-    static const double WAIT_FOR_RESPONSE_INTERVAL = 0.5;
-    static const double INPUT_BUFFER_SIZE = 64;
+    static constexpr double WAIT_FOR_RESPONSE_INTERVAL = 0.5;
+    static constexpr double INPUT_BUFFER_SIZE = 64;
     //static const int    URDF_SCALE_FACTOR = 2000;
 
 };
@@ -0,0 +1,76 @@
+/*********************************************************************************************//**
+* latency_histogram.h
+*
+* HDR-style latency histogram: log-linear buckets keep every recorded value to
+* within 1/16 of its true value from 1 us up to days, in a fixed array, so
+* recording is O(1) and tail percentiles stay meaningful after millions of
+* samples.
+*
+* *********************************************************************************************/
+
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <stdint.h>
+
+namespace inspire_hand
+{
+
+class latency_histogram
+{
+public:
+
+    //2^SUB_BITS linear sub-buckets per power of two, half of them used above the first range
+    static const int SUB_BITS = 5;
+    //Values at or above 2^MAX_BITS (us) land in the last bucket
+    static const int MAX_BITS = 40;
+    static const int BUCKETS = (1 << SUB_BITS) + (MAX_BITS - SUB_BITS) * (1 << (SUB_BITS - 1));
+
+    latency_histogram();
+
+    void record(uint64_t value);
+
+    uint64_t count() const { return count_; }
+    uint64_t min() const { return count_ ? min_ : 0; }
+    uint64_t max() const { return max_; }
+    double mean() const { return count_ ? double(sum_) / count_ : 0; }
+
+    /** \brief Upper bound of the bucket holding the p-th percentile (0..100) */
+    uint64_t percentile(double p) const;
+
+    void reset();
+
+private:
+
+    static int bucketOf(uint64_t value);
+    static uint64_t bucketHigh(int bucket);
+
+    uint32_t counts_[BUCKETS];
+    uint64_t count_;
+    uint64_t min_;
+    uint64_t max_;
+    uint64_t sum_;
+};
+
+//Latency and outcome counters of one register operation or service
+struct op_metrics
+{
+    //Microseconds
+    latency_histogram latency;
+    uint32_t ok;
+    uint32_t timeout;
+    uint32_t short_frame;
+    uint32_t corrupt;
+    uint32_t retries;
+    //Service callbacks that returned false (refused or failed)
+    uint32_t failed;
+    //Failures already reported, a diagnostics status only warns about new ones
+    uint32_t reported_failures;
+
+    op_metrics(): ok(0), timeout(0), short_frame(0), corrupt(0), retries(0), failed(0), reported_failures(0) {}
+
+    uint32_t failures() const { return timeout + short_frame + corrupt + failed; }
+};
+}
+
+#endif
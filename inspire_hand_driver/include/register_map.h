@@ -0,0 +1,177 @@
+/*********************************************************************************************//**
+* register_map.h
+*
+* Register map of the hand, in one table. Each register becomes a type in
+* namespace reg carrying its byte address, element count and width,
+* signedness, valid range, access and scale, so accessors, decoders and block
+* reads are generated and checked at compile time. REGISTER_TABLE is the same
+* list as data, for lookups by address at run time.
+*
+* Addresses are byte addresses, values little endian. Setpoint registers take
+* -1 (sent as 0xFFFF) for "keep the current target".
+*
+* *********************************************************************************************/
+
+#ifndef REGISTER_MAP_H
+#define REGISTER_MAP_H
+
+#include <stdint.h>
+
+namespace inspire_hand
+{
+
+enum register_access
+{
+    REG_R = 1,
+    REG_W = 2,
+    REG_RW = 3
+};
+
+//Data bytes one request may carry: the length byte counts command, address and data
+static constexpr int MAX_FRAME_DATA = 255 - 3;
+
+//   name            addr   count width signed   min    max  access   div  unit
+#define INSPIRE_HAND_REGISTERS(X) \
+    X(ID,             0x03E8,   1,   1, false,      1,   254, REG_RW,    1, "")       \
+    X(REDU_RATIO,     0x03E9,   1,   1, false,      0,     2, REG_RW,    1, "")       \
+    X(CLEAR_ERROR,    0x03EC,   1,   1, false,      0,     1, REG_RW,    1, "")       \
+    X(SAVE,           0x03ED,   1,   1, false,      0,     1, REG_RW,    1, "")       \
+    X(RESET_PARA,     0x03EE,   1,   1, false,      0,     1, REG_RW,    1, "")       \
+    X(GESTURE_NO,     0x03F0,   1,   1, false,      0,    45, REG_RW,    1, "")       \
+    X(FORCE_CLB,      0x03F1,   1,   1, false,      0,     1, REG_RW,    1, "")       \
+    X(CURRENT_LIMIT,  0x03FC,   6,   2, false,      0,  1500, REG_RW,    1, "mA")     \
+    X(DEFAULT_SPEED,  0x0408,   6,   2, false,      0,  1000, REG_RW, 1000, "")       \
+    X(DEFAULT_FORCE,  0x0414,   6,   2, false,      0,  1000, REG_RW, 1000, "")       \
+    X(USER_DEF_ANGLE, 0x042A, 192,   2, false,      0,  1000, REG_RW, 1000, "")       \
+    X(POS_SET,        0x05C2,   6,   2, false,     -1,  2000, REG_RW, 2000, "")       \
+    X(ANGLE_SET,      0x05CE,   6,   2, false,     -1,  1000, REG_RW, 1000, "")       \
+    X(FORCE_SET,      0x05DA,   6,   2, false,     -1,  1000, REG_RW, 1000, "")       \
+    X(SPEED_SET,      0x05F2,   6,   2, false,     -1,  1000, REG_RW, 1000, "")       \
+    X(POS_ACT,        0x05FE,   6,   2, false,      0, 65535, REG_R,  2000, "")       \
+    X(ANGLE_ACT,      0x060A,   6,   2, false,      0, 65535, REG_R,  1000, "")       \
+    X(FORCE_ACT,      0x062E,   6,   2, true,  -32768, 32767, REG_R,     1, "g")      \
+    X(CURRENT,        0x063A,   6,   2, false,      0, 65535, REG_R,     1, "mA")     \
+    X(ERROR,          0x0646,   6,   1, false,      0,   255, REG_R,     1, "")       \
+    X(STATUS,         0x064C,   6,   1, false,      0,   255, REG_R,     1, "")       \
+    X(TEMP,           0x0652,   6,   1, false,      0,   255, REG_R,     1, "C")
+
+template <uint16_t ADDR, int COUNT, int WIDTH, bool SIGNED, int MIN, int MAX, int ACCESS, int DIV>
+struct register_def
+{
+    static_assert(WIDTH == 1 || WIDTH == 2, "registers are 8 or 16 bit");
+    static_assert(MIN <= MAX, "empty range");
+
+    static constexpr uint16_t addr = ADDR;
+    static constexpr int count = COUNT;
+    static constexpr int width = WIDTH;
+    static constexpr bool is_signed = SIGNED;
+    static constexpr int min = MIN;
+    static constexpr int max = MAX;
+    static constexpr int access = ACCESS;
+    static constexpr int bytes = COUNT * WIDTH;
+    static constexpr uint16_t end = ADDR + COUNT * WIDTH;
+
+    /** \brief Element i of a little endian block starting at this register */
+    static constexpr int decode(const uint8_t *data, int i)
+    {
+        return WIDTH == 1 ? (SIGNED ? int(int8_t(data[i])) : int(data[i]))
+                          : (SIGNED ? int(int16_t(data[2 * i] | (data[2 * i + 1] << 8)))
+                                    : int(data[2 * i] | (data[2 * i + 1] << 8)));
+    }
+
+    static constexpr bool valid(int value) { return value >= MIN && value <= MAX; }
+
+    /** \brief Raw value in the register's unit (fractions of full scale where it has none) */
+    static constexpr double scaled(int value) { return double(value) / DIV; }
+};
+
+namespace reg
+{
+#define INSPIRE_HAND_REGISTER_TYPE(NAME, ADDR, COUNT, WIDTH, SIGNED, MIN, MAX, ACCESS, DIV, UNIT) \
+    struct NAME : register_def<ADDR, COUNT, WIDTH, SIGNED, MIN, MAX, ACCESS, DIV> \
+    { \
+        static constexpr const char *name() { return #NAME; } \
+        static constexpr const char *unit() { return UNIT; } \
+    };
+INSPIRE_HAND_REGISTERS(INSPIRE_HAND_REGISTER_TYPE)
+#undef INSPIRE_HAND_REGISTER_TYPE
+}
+
+/** \brief One row of the register table */
+struct register_info
+{
+    const char *name;
+    uint16_t addr;
+    uint16_t count;
+    uint8_t width;
+    bool is_signed;
+    int min;
+    int max;
+    uint8_t access;
+
+    constexpr uint16_t end() const { return addr + count * width; }
+};
+
+#define INSPIRE_HAND_REGISTER_INFO(NAME, ADDR, COUNT, WIDTH, SIGNED, MIN, MAX, ACCESS, DIV, UNIT) \
+    { #NAME, ADDR, COUNT, WIDTH, SIGNED, MIN, MAX, ACCESS },
+static constexpr register_info REGISTER_TABLE[] = { INSPIRE_HAND_REGISTERS(INSPIRE_HAND_REGISTER_INFO) };
+#undef INSPIRE_HAND_REGISTER_INFO
+static constexpr int REGISTER_COUNT = sizeof(REGISTER_TABLE) / sizeof(REGISTER_TABLE[0]);
+
+/** \brief Index of the register holding byte addr, -1 if none */
+constexpr int registerIndex(uint16_t addr, int i = 0)
+{
+    return i >= REGISTER_COUNT ? -1
+         : (addr >= REGISTER_TABLE[i].addr && addr < REGISTER_TABLE[i].end()) ? i
+         : registerIndex(addr, i + 1);
+}
+
+/** \brief True if every byte in [from, to) belongs to a writable register; gaps must never be written */
+constexpr bool writableSpan(uint16_t from, uint16_t to)
+{
+    return from >= to ? true
+         : registerIndex(from) < 0 || !(REGISTER_TABLE[registerIndex(from)].access & REG_W) ? false
+         : writableSpan(REGISTER_TABLE[registerIndex(from)].end(), to);
+}
+
+/** \brief Table in address order without overlaps */
+constexpr bool registersOrdered(int i = 1)
+{
+    return i >= REGISTER_COUNT ? true
+         : REGISTER_TABLE[i - 1].end() <= REGISTER_TABLE[i].addr && registersOrdered(i + 1);
+}
+static_assert(registersOrdered(), "register table out of order or overlapping");
+
+template <class... R> struct block_first;
+template <class R> struct block_first<R> { static constexpr uint16_t value = R::addr; };
+template <class R, class... Rest> struct block_first<R, Rest...>
+{
+    static constexpr uint16_t value = R::addr < block_first<Rest...>::value ? R::addr : block_first<Rest...>::value;
+};
+
+template <class... R> struct block_end;
+template <class R> struct block_end<R> { static constexpr uint16_t value = R::end; };
+template <class R, class... Rest> struct block_end<R, Rest...>
+{
+    static constexpr uint16_t value = R::end > block_end<Rest...>::value ? R::end : block_end<Rest...>::value;
+};
+
+/** \brief One read covering several registers; bytes between them are read and ignored */
+template <class... R>
+struct register_block
+{
+    static constexpr uint16_t addr = block_first<R...>::value;
+    static constexpr uint16_t end = block_end<R...>::value;
+    static constexpr int bytes = end - addr;
+    static_assert(bytes <= MAX_FRAME_DATA, "block does not fit in one frame");
+
+    /** \brief Element i of register X out of the block's data */
+    template <class X>
+    static constexpr int decode(const uint8_t *data, int i)
+    {
+        return X::decode(data + (X::addr - addr), i);
+    }
+};
+}
+
+#endif
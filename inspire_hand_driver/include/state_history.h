@@ -0,0 +1,119 @@
+/*********************************************************************************************//**
+* state_history.h
+*
+* Fixed-capacity ring of recent hand state in structure-of-arrays layout: one
+* array per channel per DOF plus one array of timestamps and one of valid
+* bits, each aligned for vector loads. Filters, derivatives and windowed
+* statistics run directly over the arrays; window() hands out the slots of a
+* time window as at most two contiguous runs, so nothing is copied, and
+* stats() aggregates one channel over such a window.
+*
+* Not synchronized, the owner serializes push() against readers.
+*
+* *********************************************************************************************/
+
+#ifndef STATE_HISTORY_H
+#define STATE_HISTORY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace inspire_hand
+{
+
+class state_history
+{
+public:
+
+    static const int DOF = 6;
+    //Same order as the HandState channel bits, channel c is valid when bit (1 << c) is set
+    enum channel
+    {
+        CH_ANGLE,
+        CH_FORCE,
+        CH_CURRENT,
+        CH_STATUS,
+        CH_ERROR,
+        CH_TEMP,
+        CHANNEL_COUNT
+    };
+    //Every array starts on a cache line
+    static const size_t ALIGNMENT = 64;
+    static const size_t MIN_CAPACITY = 16;
+
+    //Contiguous slots [first, first + count)
+    struct run
+    {
+        size_t first;
+        size_t count;
+    };
+
+    //Aggregates of one channel of one DOF over a window, from the samples where the channel was read
+    struct window_stats
+    {
+        uint32_t count;
+        float min;
+        float max;
+        float mean;
+        float rms;
+        float percentile;
+    };
+
+    state_history();
+    ~state_history();
+
+    /** \brief Drop the history and allocate room for capacity samples, rounded up to a power of two. 0 frees it */
+    bool allocate(size_t capacity);
+
+    /** \brief Append one sample; channels not in valid keep their slot but are flagged as stale.
+     *  Stamps must not go backwards */
+    void push(int64_t stamp_ns, uint8_t valid, const float *angle, const float *force, const float *current,
+              const float *status, const float *error, const float *temp);
+
+    void clear() { pushed_ = 0; }
+
+    size_t capacity() const { return capacity_; }
+    //Samples held
+    size_t size() const { return pushed_ < capacity_ ? size_t(pushed_) : capacity_; }
+    //Samples pushed since the last clear
+    uint64_t pushed() const { return pushed_; }
+
+    //Arrays indexed by slot
+    const float *data(int channel, int dof) const { return data_ + (size_t(channel) * DOF + dof) * capacity_; }
+    const int64_t *stamps() const { return stamps_; }
+    const uint8_t *valid() const { return valid_; }
+
+    /** \brief Slot of the sample age samples old, 0 is the newest. age must be below size() */
+    size_t slot(size_t age) const { return size_t(pushed_ - 1 - age) & (capacity_ - 1); }
+
+    /** \brief Samples stamped within [from_ns, to_ns], oldest first, as up to two runs of slots.
+     *  Returns the number of samples */
+    size_t window(int64_t from_ns, int64_t to_ns, run runs[2]) const;
+
+    /** \brief Min, max, mean, RMS and the given percentile (0..100, nearest rank) of one channel of
+     *  one DOF over runs from window(). scratch holds the copy the percentile is selected from,
+     *  pass NULL to skip it. All zero when the channel was never read in the window */
+    void stats(int channel, int dof, const run runs[2], double percentile, window_stats &out,
+               std::vector<float> *scratch) const;
+
+private:
+
+    state_history(const state_history &);
+    state_history &operator=(const state_history &);
+
+    //Slot of the index-th oldest sample held
+    size_t ordered(size_t index) const { return size_t(pushed_ - size() + index) & (capacity_ - 1); }
+    //Index of the first held sample stamped at or after stamp_ns (size() if none)
+    size_t lowerBound(int64_t stamp_ns) const;
+
+    void *block_;
+    size_t capacity_;
+    uint64_t pushed_;
+    int64_t *stamps_;
+    uint8_t *valid_;
+    float *data_;
+};
+}
+
+#endif
@@ -0,0 +1,117 @@
+/*********************************************************************************************//**
+* state_logger.h
+*
+* Asynchronous binary logger for hand state samples. The acquisition loop
+* pushes fixed-size records into a lock-free single-producer ring, a
+* background thread batches them to disk. hand_log_to_csv converts a log
+* back to text.
+*
+* *********************************************************************************************/
+
+#ifndef STATE_LOGGER_H
+#define STATE_LOGGER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+
+namespace inspire_hand
+{
+
+//Channels stored in a log record
+enum log_channel
+{
+    LOG_ANGLE_ACT = 0,
+    LOG_FORCE_ACT = 1,
+    LOG_CURRENT = 2,
+    LOG_ERROR = 3,
+    LOG_STATUS = 4,
+    LOG_TEMP = 5,
+    LOG_ANGLE_SET = 6,
+    LOG_FORCE_SET = 7,
+    LOG_POS_ACT = 8,
+    LOG_CHANNEL_COUNT
+};
+
+const char *log_channel_name(uint8_t channel);
+
+#pragma pack(push, 1)
+/** \brief File header, followed by a flat array of log_record */
+struct log_file_header
+{
+    char magic[4];          //"IHLG"
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t hand_id;
+};
+
+/** \brief One six-DOF sample, 22 bytes on disk (little endian) */
+struct log_record
+{
+    uint64_t stamp_ns;      //wall clock, ns since epoch
+    uint8_t channel;        //log_channel
+    uint8_t hand_id;
+    int16_t value[6];
+};
+#pragma pack(pop)
+
+class state_logger
+{
+public:
+
+    static const uint16_t VERSION = 1;
+
+    state_logger();
+
+    ~state_logger();
+
+    /** \brief Open the log file and start the writer thread, capacity is rounded up to a power of two */
+    bool open(const std::string &path, int hand_id = 0, size_t capacity = 1 << 14);
+
+    /** \brief Drain the queue, stop the writer thread and close the file */
+    void close();
+
+    bool isOpen() const { return file_ != NULL; }
+
+    /** \brief Queue one sample, never blocks; returns false (and counts a drop) if the queue is full.
+     *  Must only be called from a single producer thread. stamp_ns == 0 stamps with now(). */
+    bool log(uint8_t channel, const float *value, uint64_t stamp_ns = 0);
+
+    //Records lost because the writer fell behind
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    uint64_t written() const { return written_.load(std::memory_order_relaxed); }
+
+    /** \brief Wall clock in ns, cheap (vDSO) and independent of the ROS master */
+    static uint64_t now();
+
+    /** \brief Read a whole log file, used by the CSV converter */
+    static bool readFile(const std::string &path, log_file_header &header, std::vector<log_record> &records);
+
+private:
+
+    void writerLoop();
+
+    std::vector<log_record> ring_;
+    size_t mask_;
+    //head_ is only written by the producer, tail_ only by the writer thread.
+    //Padded apart so they do not share a cache line (without over-aligning the owner)
+    char pad0_[64];
+    std::atomic<size_t> head_;
+    char pad1_[64];
+    std::atomic<size_t> tail_;
+    char pad2_[64];
+    std::atomic<uint64_t> dropped_;
+    std::atomic<uint64_t> written_;
+    std::atomic<bool> running_;
+
+    uint8_t hand_id_;
+    FILE *file_;
+    std::thread writer_;
+};
+}
+
+#endif
@@ -0,0 +1,114 @@
+/*********************************************************************************************//**
+* state_shm.h
+*
+* Latest hand state in a named POSIX shared-memory segment, for consumers on
+* the same host that do not want to go through a ROS topic. One writer (the
+* driver) updates a single sample under a seqlock: the sequence number is odd
+* while the sample is being written, readers copy the sample and retry if the
+* sequence moved. Readers never block the writer and need no system call per
+* read.
+*
+* Link against inspire_hand_shm (ROS independent, needs -lrt on older glibc).
+*
+* *********************************************************************************************/
+
+#ifndef STATE_SHM_H
+#define STATE_SHM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <atomic>
+
+namespace inspire_hand
+{
+
+/** \brief One decoded state sample, same channels as HandState */
+struct shm_state_sample
+{
+    uint64_t stamp_ns;      //wall clock of the FORCE_ACT read of the cycle, ns since epoch
+    uint64_t publish_ns;    //wall clock when the sample went into the segment
+    uint32_t cycle;         //poll cycle counter of the driver
+    uint8_t hand_id;
+    uint8_t valid;          //HandState channel bits refreshed in this cycle
+    uint8_t dof_mask;
+    uint8_t reserved;
+    int16_t angle[6];
+    int16_t force[6];
+    int16_t current[6];
+    uint8_t status[6];
+    uint8_t error[6];
+    uint8_t temp[6];
+    uint8_t pad[6];
+};
+
+/** \brief Layout of the segment */
+struct shm_state_segment
+{
+    char magic[4];                  //"IHSM"
+    uint16_t version;
+    uint16_t sample_size;
+    std::atomic<uint32_t> alive;    //1 while a writer has the segment open
+    std::atomic<uint32_t> seq;      //odd while the sample is being written
+    shm_state_sample sample;
+};
+
+class state_shm_writer
+{
+public:
+
+    static const uint16_t VERSION = 1;
+
+    state_shm_writer();
+
+    ~state_shm_writer();
+
+    /** \brief Create (or take over) the segment, name as for shm_open ("/inspire_hand_1") */
+    bool open(const std::string &name);
+
+    /** \brief Mark the segment dead and remove the name, readers keep their mapping and the last sample */
+    void close();
+
+    bool isOpen() const { return segment_ != NULL; }
+
+    /** \brief Single writer only */
+    void publish(const shm_state_sample &sample);
+
+private:
+
+    std::string name_;
+    shm_state_segment *segment_;
+};
+
+class state_shm_reader
+{
+public:
+
+    state_shm_reader();
+
+    ~state_shm_reader();
+
+    /** \brief Map an existing segment read-only, false if it does not exist or has another layout */
+    bool open(const std::string &name);
+
+    void close();
+
+    bool isOpen() const { return segment_ != NULL; }
+
+    /** \brief Copy the latest sample; false if nothing was published yet or the writer kept
+     *  overwriting it for max_tries attempts. seq (if given) gets the sample's sequence number */
+    bool read(shm_state_sample &sample, uint32_t *seq = NULL, int max_tries = 1000) const;
+
+    /** \brief Sequence number of the latest complete sample, cheap check for news */
+    uint32_t sequence() const;
+
+    /** \brief False once the writer closed the segment */
+    bool writerAlive() const;
+
+private:
+
+    const shm_state_segment *segment_;
+};
+}
+
+#endif
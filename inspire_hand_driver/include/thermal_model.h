@@ -0,0 +1,76 @@
+/*********************************************************************************************//**
+* thermal_model.h
+*
+* First-order thermal model per actuator: at a steady current I the actuator
+* settles at ambient + gain * I^2 with time constant tau. Every TEMP reading
+* pulls the estimate back towards the measurement. From the estimate and the
+* present current the model predicts the time left until the temperature
+* limit and derives a speed scale that eases off before the limit is hit,
+* instead of the hand tripping its protection.
+*
+* *********************************************************************************************/
+
+#ifndef THERMAL_MODEL_H
+#define THERMAL_MODEL_H
+
+#include <stdint.h>
+
+namespace inspire_hand
+{
+
+class thermal_model
+{
+public:
+
+    static const int DOF = 6;
+    //Scales change in steps of this size, so a slow drift does not rewrite SPEED_SET every update
+    static constexpr double SCALE_STEP = 0.05;
+    //Time constant (s) of the current average the prediction runs on; heating follows the
+    //instantaneous current, but a single grasp should not swing the throttle
+    static constexpr double CURRENT_AVERAGE = 10.0;
+    //A scale is raised at most once per RAISE_HOLD (s), lowering is never held back
+    static constexpr double RAISE_HOLD = 5.0;
+
+    thermal_model();
+
+    //gain: 稳态温升 (°C/A^2), tau: 时间常数 (s), limit: 温度上限 (°C)
+    void setActuator(int dof, double gain, double tau, double limit);
+    void setAmbient(double ambient) { ambient_ = ambient; }
+    //Speed is scaled down once the predicted time to limit drops below horizon (s), never below min_scale
+    void setThrottle(double horizon, double min_scale);
+    //Weight of a TEMP reading against the estimate (0..1)
+    void setCorrection(double correction) { correction_ = correction; }
+
+    /** \brief Advance the model by dt (s) at the given currents (mA); temp (°C) may be NULL if not read.
+     *  Returns a bit mask of the DOFs whose speed scale changed */
+    uint8_t update(double dt, const float *current, const float *temp);
+
+    double temperature(int dof) const { return temp_[dof]; }
+    //Seconds until the limit at the present current, negative if it is never reached
+    double timeToLimit(int dof) const { return time_to_limit_[dof]; }
+    double scale(int dof) const { return scale_[dof]; }
+    //DOFs running below full speed
+    uint8_t throttled() const;
+
+    void reset();
+
+private:
+
+    double gain_[DOF];
+    double tau_[DOF];
+    double limit_[DOF];
+    double ambient_;
+    double horizon_;
+    double min_scale_;
+    double correction_;
+
+    bool initialized_;
+    double temp_[DOF];
+    double amps_sq_avg_[DOF];
+    double since_change_[DOF];
+    double time_to_limit_[DOF];
+    double scale_[DOF];
+};
+}
+
+#endif
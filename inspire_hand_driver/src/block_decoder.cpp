@@ -0,0 +1,177 @@
+#include <block_decoder.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BLOCK_DECODER_X86
+#include <immintrin.h>
+#endif
+
+namespace inspire_hand
+{
+
+const int block_decoder::DOF;
+const size_t block_decoder::BLOCK_BYTES;
+
+block_decoder::path
+block_decoder::bestPath()
+{
+#ifdef BLOCK_DECODER_X86
+    if (__builtin_cpu_supports("avx2"))
+        return PATH_AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return PATH_SSE2;
+#endif
+    return PATH_SCALAR;
+}
+
+const char *
+block_decoder::pathName(path p)
+{
+    switch (p)
+    {
+    case PATH_SSE2: return "sse2";
+    case PATH_AVX2: return "avx2";
+    default: return "scalar";
+    }
+}
+
+void
+block_decoder::decodeScalar(const uint8_t *data, size_t stride, size_t first, size_t count, bool is_signed,
+                            float *const out[DOF])
+{
+    for (size_t k = first; k < first + count; k++)
+    {
+        const uint8_t *block = data + k * stride;
+        for (int i = 0; i < DOF; i++)
+        {
+            int temp = ((block[2 * i + 1] << 8) & 0xff00) + block[2 * i];
+            if (is_signed)
+                temp = int16_t(temp);
+            out[i][k] = float(temp);
+        }
+    }
+}
+
+#ifdef BLOCK_DECODER_X86
+
+//Each block is loaded as one 16 byte vector: the six values in lanes 0-5, lanes 6 and 7 are
+//whatever follows (checksum, next frame) and are never stored.
+//Four such rows are transposed with unpacks so each DOF ends up in one 64 bit half
+static inline void
+transpose4(const uint8_t *data, size_t stride, __m128i &d01, __m128i &d23, __m128i &d45)
+{
+    __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+    __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + stride));
+    __m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 2 * stride));
+    __m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 3 * stride));
+    __m128i t0 = _mm_unpacklo_epi16(r0, r1);
+    __m128i t1 = _mm_unpacklo_epi16(r2, r3);
+    __m128i t2 = _mm_unpackhi_epi16(r0, r1);
+    __m128i t3 = _mm_unpackhi_epi16(r2, r3);
+    d01 = _mm_unpacklo_epi32(t0, t1);
+    d23 = _mm_unpackhi_epi32(t0, t1);
+    d45 = _mm_unpacklo_epi32(t2, t3);
+}
+
+//Widen the four 16 bit values in the low (hi = false) or high half to float
+static inline __m128
+widen4(__m128i v, bool hi, bool is_signed)
+{
+    __m128i w;
+    if (is_signed)
+        w = _mm_srai_epi32(hi ? _mm_unpackhi_epi16(v, v) : _mm_unpacklo_epi16(v, v), 16);
+    else
+        w = hi ? _mm_unpackhi_epi16(v, _mm_setzero_si128()) : _mm_unpacklo_epi16(v, _mm_setzero_si128());
+    return _mm_cvtepi32_ps(w);
+}
+
+static void
+decodeSSE2(const uint8_t *data, size_t stride, size_t count, bool is_signed, float *const out[block_decoder::DOF])
+{
+    for (size_t k = 0; k + 4 <= count; k += 4)
+    {
+        __m128i d[3];
+        transpose4(data + k * stride, stride, d[0], d[1], d[2]);
+        for (int j = 0; j < 3; j++)
+        {
+            _mm_storeu_ps(out[2 * j] + k, widen4(d[j], false, is_signed));
+            _mm_storeu_ps(out[2 * j + 1] + k, widen4(d[j], true, is_signed));
+        }
+    }
+}
+
+//Same transpose on two 128 bit lanes, blocks k..k+3 in the low lane and k+4..k+7 in the high one.
+//Unpacking a DOF pair with itself then gives that DOF for all eight blocks in order
+__attribute__((target("avx2")))
+static void
+decodeAVX2(const uint8_t *data, size_t stride, size_t count, bool is_signed, float *const out[block_decoder::DOF])
+{
+    for (size_t k = 0; k + 8 <= count; k += 8)
+    {
+        const uint8_t *b = data + k * stride;
+        __m256i r[4];
+        for (int j = 0; j < 4; j++)
+        {
+            __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + j * stride));
+            __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + (j + 4) * stride));
+            r[j] = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        }
+        __m256i t0 = _mm256_unpacklo_epi16(r[0], r[1]);
+        __m256i t1 = _mm256_unpacklo_epi16(r[2], r[3]);
+        __m256i t2 = _mm256_unpackhi_epi16(r[0], r[1]);
+        __m256i t3 = _mm256_unpackhi_epi16(r[2], r[3]);
+        __m256i d[3] = { _mm256_unpacklo_epi32(t0, t1), _mm256_unpackhi_epi32(t0, t1), _mm256_unpacklo_epi32(t2, t3) };
+        for (int j = 0; j < 3; j++)
+        {
+            __m256i even;
+            __m256i odd;
+            if (is_signed)
+            {
+                even = _mm256_srai_epi32(_mm256_unpacklo_epi16(d[j], d[j]), 16);
+                odd = _mm256_srai_epi32(_mm256_unpackhi_epi16(d[j], d[j]), 16);
+            }
+            else
+            {
+                even = _mm256_unpacklo_epi16(d[j], _mm256_setzero_si256());
+                odd = _mm256_unpackhi_epi16(d[j], _mm256_setzero_si256());
+            }
+            _mm256_storeu_ps(out[2 * j] + k, _mm256_cvtepi32_ps(even));
+            _mm256_storeu_ps(out[2 * j + 1] + k, _mm256_cvtepi32_ps(odd));
+        }
+    }
+}
+
+#endif
+
+void
+block_decoder::decode(const uint8_t *data, size_t stride, size_t count, bool is_signed, float *const out[DOF], path p)
+{
+    if (count == 0)
+        return;
+    size_t done = 0;
+#ifdef BLOCK_DECODER_X86
+    //Vector loads take 16 bytes per block, only blocks with that much buffer behind them qualify
+    size_t end = (count - 1) * stride + BLOCK_BYTES;
+    size_t loadable = end >= 16 ? (end - 16) / stride + 1 : 0;
+    if (loadable > count)
+        loadable = count;
+    if (p == PATH_AVX2)
+    {
+        done = loadable & ~size_t(7);
+        decodeAVX2(data, stride, done, is_signed, out);
+    }
+    //SSE2 also picks up what is left of the AVX2 groups
+    if (p == PATH_AVX2 || p == PATH_SSE2)
+    {
+        size_t n = (loadable - done) & ~size_t(3);
+        float *shifted[DOF];
+        for (int i = 0; i < DOF; i++)
+            shifted[i] = out[i] + done;
+        decodeSSE2(data + done * stride, stride, n, is_signed, shifted);
+        done += n;
+    }
+#else
+    (void)p;
+#endif
+    decodeScalar(data, stride, done, count - done, is_signed, out);
+}
+}
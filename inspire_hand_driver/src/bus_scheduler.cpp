@@ -0,0 +1,101 @@
+#include <bus_scheduler.h>
+
+#include <chrono>
+
+namespace inspire_hand
+{
+
+bus_scheduler::bus_scheduler():
+    busy_(false),
+    next_seq_(0),
+    granted_(0)
+{
+    for (int c = 0; c < BUS_CLASS_COUNT; c++)
+    {
+        max_wait_[c] = 0;
+        promoted_[c] = 0;
+    }
+}
+
+void
+bus_scheduler::setMaxWait(int cls, uint64_t max_wait_us)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_wait_[cls] = max_wait_us;
+}
+
+uint64_t
+bus_scheduler::nowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t
+bus_scheduler::acquire(int cls)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    ticket t;
+    t.seq = ++next_seq_;
+    t.since_us = nowUs();
+    waiting_[cls].push_back(t);
+    if (!busy_)
+        grantNext();
+    //The grant names one ticket, so wakeups of other waiters change nothing
+    while (granted_ != t.seq)
+        granted_cv_.wait(lock);
+
+    uint64_t delay = nowUs() - t.since_us;
+    delay_[cls].record(delay);
+    return delay;
+}
+
+void
+bus_scheduler::release()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    busy_ = false;
+    grantNext();
+}
+
+void
+bus_scheduler::grantNext()
+{
+    int first = -1;
+    for (int c = 0; c < BUS_CLASS_COUNT && first < 0; c++)
+    {
+        if (!waiting_[c].empty())
+            first = c;
+    }
+    if (first < 0)
+        return;
+
+    //Of the waiters past their max wait the oldest goes first, that is the reserved slot
+    uint64_t now = nowUs();
+    int pick = -1;
+    for (int c = 0; c < BUS_CLASS_COUNT; c++)
+    {
+        if (waiting_[c].empty() || max_wait_[c] == 0 || now - waiting_[c].front().since_us < max_wait_[c])
+            continue;
+        if (pick < 0 || waiting_[c].front().seq < waiting_[pick].front().seq)
+            pick = c;
+    }
+    if (pick < 0)
+        pick = first;
+    else if (pick != first)
+        promoted_[pick]++;
+
+    granted_ = waiting_[pick].front().seq;
+    waiting_[pick].pop_front();
+    busy_ = true;
+    granted_cv_.notify_all();
+}
+
+void
+bus_scheduler::stats(int cls, latency_histogram &delay, uint32_t &promoted) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    delay = delay_[cls];
+    promoted = promoted_[cls];
+}
+}
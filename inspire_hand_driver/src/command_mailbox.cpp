@@ -0,0 +1,131 @@
+#include <command_mailbox.h>
+
+#include <stddef.h>
+
+namespace inspire_hand
+{
+
+void
+setpoint_targets::clear()
+{
+    for (int f = 0; f < SP_FIELD_COUNT; f++)
+        for (int i = 0; i < 6; i++)
+            value[f][i] = -1;
+    oldest_stamp_ns = 0;
+}
+
+bool
+setpoint_targets::any(int field) const
+{
+    for (int i = 0; i < 6; i++)
+        if (value[field][i] >= 0)
+            return true;
+    return false;
+}
+
+command_mailbox::command_mailbox():
+    received_(0),
+    coalesced_(0),
+    expired_(0),
+    rejected_(0)
+{
+    for (int f = 0; f < SP_FIELD_COUNT; f++)
+        for (int i = 0; i < 6; i++)
+            slot_[f][i].pending = false;
+    for (int i = 0; i < 6; i++)
+        owner_[i].owned = false;
+}
+
+uint8_t
+command_mailbox::post(uint8_t source, uint8_t priority, uint8_t dof_mask, const int16_t *const value[SP_FIELD_COUNT],
+                      uint64_t stamp_ns, uint64_t deadline_ns, uint64_t now_ns, uint64_t lease_until_ns)
+{
+    received_++;
+
+    //Ownership is per DOF, every field of a DOF follows its owner
+    uint8_t accepted = 0;
+    for (int i = 0; i < 6; i++)
+    {
+        if (!(dof_mask & (1 << i)))
+            continue;
+        owner &o = owner_[i];
+        bool held = o.owned && o.source != source && now_ns < o.lease_until_ns;
+        if (held && o.priority > priority)
+        {
+            rejected_++;
+            continue;
+        }
+        //Targets still pending from the previous owner must not be mixed with the new one's
+        if (o.owned && o.source != source)
+            for (int f = 0; f < SP_FIELD_COUNT; f++)
+                slot_[f][i].pending = false;
+        o.owned = true;
+        o.source = source;
+        o.priority = priority;
+        o.lease_until_ns = lease_until_ns;
+        accepted |= 1 << i;
+    }
+
+    for (int f = 0; f < SP_FIELD_COUNT; f++)
+    {
+        if (value[f] == NULL)
+            continue;
+        for (int i = 0; i < 6; i++)
+        {
+            if (!(accepted & (1 << i)) || value[f][i] < 0)
+                continue;
+            slot &s = slot_[f][i];
+            //Out of order delivery must not replace a newer target with an older one
+            if (s.pending && s.stamp_ns > stamp_ns)
+            {
+                coalesced_++;
+                continue;
+            }
+            if (s.pending)
+                coalesced_++;
+            s.pending = true;
+            s.value = value[f][i];
+            s.stamp_ns = stamp_ns;
+            s.deadline_ns = deadline_ns;
+        }
+    }
+    return accepted;
+}
+
+bool
+command_mailbox::take(uint64_t now_ns, setpoint_targets &out)
+{
+    out.clear();
+    bool any = false;
+    for (int f = 0; f < SP_FIELD_COUNT; f++)
+    {
+        for (int i = 0; i < 6; i++)
+        {
+            slot &s = slot_[f][i];
+            if (!s.pending)
+                continue;
+            s.pending = false;
+            if (s.deadline_ns != 0 && now_ns > s.deadline_ns)
+            {
+                expired_++;
+                continue;
+            }
+            out.value[f][i] = s.value;
+            if (out.oldest_stamp_ns == 0 || s.stamp_ns < out.oldest_stamp_ns)
+                out.oldest_stamp_ns = s.stamp_ns;
+            any = true;
+        }
+    }
+    return any;
+}
+
+bool
+command_mailbox::pending() const
+{
+    for (int f = 0; f < SP_FIELD_COUNT; f++)
+        for (int i = 0; i < 6; i++)
+            if (slot_[f][i].pending)
+                return true;
+    return false;
+}
+}
@@ -0,0 +1,206 @@
+#include <command_shm.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+namespace inspire_hand
+{
+
+//Producer and driver see the counters as plain words
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && sizeof(std::atomic<uint64_t>) == 8,
+              "shared counters must be lock free 64 bit words");
+
+const uint32_t shm_command_ring::CAPACITY;
+
+command_shm_reader::command_shm_reader():
+    ring_(NULL),
+    last_(0),
+    taken_(0),
+    lost_(0)
+{
+}
+
+command_shm_reader::~command_shm_reader()
+{
+    close();
+}
+
+bool
+command_shm_reader::open(const std::string &name, int group)
+{
+    close();
+    //Whoever can write the ring drives the actuators: only the driver's user, or that user and one group.
+    //A segment left by an earlier run is removed, O_EXCL then guarantees the one mapped is our own
+    mode_t mode = group >= 0 ? 0660 : 0600;
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, mode);
+    if (fd < 0)
+        return false;
+    //The umask may have narrowed the mode, the group needs its bits back
+    struct stat st;
+    if ((group >= 0 && fchown(fd, -1, gid_t(group)) != 0) || fchmod(fd, mode) != 0 || fstat(fd, &st) != 0 ||
+        st.st_uid != geteuid() || (st.st_mode & 0777) != mode || ftruncate(fd, sizeof(shm_command_ring)) != 0)
+    {
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    void *p = mmap(NULL, sizeof(shm_command_ring), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+        return false;
+
+    //Whatever a previous run left in the ring is not replayed
+    ring_ = static_cast<shm_command_ring *>(p);
+    memcpy(ring_->magic, "IHCR", 4);
+    ring_->version = VERSION;
+    ring_->entry_size = sizeof(shm_command);
+    ring_->capacity = shm_command_ring::CAPACITY;
+    last_ = ring_->head.load(std::memory_order_acquire);
+    ring_->consumed.store(last_, std::memory_order_release);
+    ring_->alive.store(1, std::memory_order_release);
+    name_ = name;
+    taken_ = 0;
+    lost_ = 0;
+    return true;
+}
+
+void
+command_shm_reader::close()
+{
+    if (ring_ == NULL)
+        return;
+    ring_->alive.store(0, std::memory_order_release);
+    munmap(ring_, sizeof(shm_command_ring));
+    shm_unlink(name_.c_str());
+    ring_ = NULL;
+}
+
+size_t
+command_shm_reader::take(std::vector<shm_command> &out)
+{
+    if (ring_ == NULL)
+        return 0;
+    uint64_t head = ring_->head.load(std::memory_order_acquire);
+    if (head == last_)
+        return 0;
+    //Writers continue the numbering, a head going backwards means the segment was
+    //initialized again behind our back: start from its beginning
+    if (head < last_)
+        last_ = 0;
+
+    size_t count = 0;
+    uint64_t first = last_ + 1;
+    if (head - last_ > shm_command_ring::CAPACITY)
+    {
+        first = head - shm_command_ring::CAPACITY + 1;
+        lost_ += first - last_ - 1;
+    }
+    for (uint64_t n = first; n <= head; n++)
+    {
+        shm_command_ring::slot &s = ring_->slots[n % shm_command_ring::CAPACITY];
+        if (s.seq.load(std::memory_order_acquire) != n)
+        {
+            lost_++;
+            continue;
+        }
+        shm_command c;
+        memcpy(&c, &s.command, sizeof(c));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.seq.load(std::memory_order_relaxed) != n)
+        {
+            lost_++;
+            continue;
+        }
+        c.seq = n;
+        out.push_back(c);
+        count++;
+    }
+    last_ = head;
+    taken_ += count;
+    ring_->consumed.store(head, std::memory_order_release);
+    return count;
+}
+
+command_shm_writer::command_shm_writer():
+    ring_(NULL),
+    next_(0)
+{
+}
+
+command_shm_writer::~command_shm_writer()
+{
+    close();
+}
+
+bool
+command_shm_writer::open(const std::string &name)
+{
+    close();
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(shm_command_ring))
+    {
+        ::close(fd);
+        return false;
+    }
+    void *p = mmap(NULL, sizeof(shm_command_ring), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+        return false;
+
+    shm_command_ring *ring = static_cast<shm_command_ring *>(p);
+    if (memcmp(ring->magic, "IHCR", 4) != 0 || ring->version != command_shm_reader::VERSION
+        || ring->entry_size != sizeof(shm_command) || ring->capacity != shm_command_ring::CAPACITY)
+    {
+        munmap(p, sizeof(shm_command_ring));
+        return false;
+    }
+    ring_ = ring;
+    //A restarted producer continues the numbering, the driver never sees it go backwards
+    next_ = ring_->head.load(std::memory_order_acquire) + 1;
+    return true;
+}
+
+void
+command_shm_writer::close()
+{
+    if (ring_ == NULL)
+        return;
+    munmap(ring_, sizeof(shm_command_ring));
+    ring_ = NULL;
+}
+
+uint64_t
+command_shm_writer::post(const shm_command &command)
+{
+    if (ring_ == NULL)
+        return 0;
+    uint64_t n = next_++;
+    shm_command_ring::slot &s = ring_->slots[n % shm_command_ring::CAPACITY];
+    s.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&s.command, &command, sizeof(command));
+    s.command.seq = n;
+    s.seq.store(n, std::memory_order_release);
+    ring_->head.store(n, std::memory_order_release);
+    return n;
+}
+
+uint64_t
+command_shm_writer::consumed() const
+{
+    return ring_ ? ring_->consumed.load(std::memory_order_acquire) : 0;
+}
+
+bool
+command_shm_writer::readerAlive() const
+{
+    return ring_ != NULL && ring_->alive.load(std::memory_order_acquire) != 0;
+}
+}
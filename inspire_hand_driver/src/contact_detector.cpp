@@ -0,0 +1,47 @@
+#include <contact_detector.h>
+
+namespace inspire_hand
+{
+
+contact_detector::contact_detector()
+{
+    for (int i = 0; i < DOF; i++)
+        setThreshold(i, 100, 50);
+    reset();
+}
+
+void
+contact_detector::setThreshold(int dof, float onset, float release)
+{
+    if (dof < 0 || dof >= DOF)
+        return;
+    if (release > onset)
+        release = onset;
+    onset_[dof] = onset;
+    release_[dof] = release;
+}
+
+uint8_t
+contact_detector::update(const float *force)
+{
+    uint8_t changed = 0;
+    for (int i = 0; i < DOF; i++)
+    {
+        //A finger only leaves contact once force drops below the (lower) release threshold
+        bool contact = contact_[i] ? (force[i] > release_[i]) : (force[i] >= onset_[i]);
+        if (contact != contact_[i])
+        {
+            contact_[i] = contact;
+            changed |= (1 << i);
+        }
+    }
+    return changed;
+}
+
+void
+contact_detector::reset()
+{
+    for (int i = 0; i < DOF; i++)
+        contact_[i] = false;
+}
+}
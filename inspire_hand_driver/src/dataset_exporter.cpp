@@ -0,0 +1,353 @@
+#include <dataset_exporter.h>
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+namespace inspire_hand
+{
+
+const char *
+dataset_channel_name(int channel)
+{
+    static const char *names[DS_CHANNEL_COUNT] = {
+        "angle_cmd", "angle_act", "force_act", "current", "temp"
+    };
+    return channel >= 0 && channel < DS_CHANNEL_COUNT ? names[channel] : "unknown";
+}
+
+//Chunk payload size with the trailing padding that keeps the next header 8 byte aligned
+static size_t
+chunk_payload_size(uint32_t rows)
+{
+    size_t size = rows * sizeof(uint64_t) + (size_t)DS_CHANNEL_COUNT * DS_DOF * rows * sizeof(int16_t);
+    return (size + 7) & ~(size_t)7;
+}
+
+////////////////////////////////////////////////////
+//WRITER
+////////////////////////////////////////////////////
+
+dataset_writer::dataset_writer():
+    file_(NULL),
+    chunk_rows_(0),
+    rows_(0),
+    stop_(false)
+{
+}
+
+dataset_writer::~dataset_writer()
+{
+    close();
+}
+
+bool
+dataset_writer::open(const std::string &path, int hand_id, uint32_t chunk_rows)
+{
+    close();
+
+    file_ = fopen(path.c_str(), "wb");
+    if (file_ == NULL)
+        return false;
+
+    chunk_rows_ = chunk_rows > 0 ? chunk_rows : 1024;
+    rows_ = 0;
+    current_.rows = 0;
+    current_.stamp.assign(chunk_rows_, 0);
+    current_.column.assign((size_t)DS_CHANNEL_COUNT * DS_DOF * chunk_rows_, 0);
+    index_.clear();
+
+    dataset_file_header header;
+    memcpy(header.magic, "IHDS", 4);
+    header.version = VERSION;
+    header.dof = DS_DOF;
+    header.channels = DS_CHANNEL_COUNT;
+    header.reserved = 0;
+    header.hand_id = hand_id;
+    header.chunk_rows = chunk_rows_;
+    header.reserved2 = 0;
+    fwrite(&header, sizeof(header), 1, file_);
+
+    stop_ = false;
+    writer_ = std::thread(&dataset_writer::writerLoop, this);
+    return true;
+}
+
+void
+dataset_writer::append(uint64_t stamp_ns, const float value[DS_CHANNEL_COUNT][DS_DOF])
+{
+    if (file_ == NULL)
+        return;
+
+    uint32_t r = current_.rows;
+    current_.stamp[r] = stamp_ns;
+    for (int c = 0; c < DS_CHANNEL_COUNT; c++)
+        for (int d = 0; d < DS_DOF; d++)
+            current_.column[(c * DS_DOF + d) * chunk_rows_ + r] = (int16_t)value[c][d];
+    current_.rows++;
+    rows_++;
+
+    if (current_.rows == chunk_rows_)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.push_back(chunk());
+        pending_.back().stamp.swap(current_.stamp);
+        pending_.back().column.swap(current_.column);
+        pending_.back().rows = current_.rows;
+        current_.rows = 0;
+        current_.stamp.assign(chunk_rows_, 0);
+        current_.column.assign((size_t)DS_CHANNEL_COUNT * DS_DOF * chunk_rows_, 0);
+        cond_.notify_one();
+    }
+}
+
+void
+dataset_writer::close()
+{
+    if (file_ == NULL)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (current_.rows > 0)
+        {
+            pending_.push_back(current_);
+            current_.rows = 0;
+        }
+        stop_ = true;
+        cond_.notify_one();
+    }
+    if (writer_.joinable())
+        writer_.join();
+
+    dataset_footer footer;
+    footer.index_offset = (uint64_t)ftell(file_);
+    footer.chunk_count = index_.size();
+    memcpy(footer.magic, "IDX1", 4);
+    if (!index_.empty())
+        fwrite(&index_[0], sizeof(dataset_index_entry), index_.size(), file_);
+    fwrite(&footer, sizeof(footer), 1, file_);
+    fclose(file_);
+    file_ = NULL;
+}
+
+void
+dataset_writer::writerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        cond_.wait(lock, [this] { return stop_ || !pending_.empty(); });
+        while (!pending_.empty())
+        {
+            chunk c;
+            c.rows = pending_.front().rows;
+            c.stamp.swap(pending_.front().stamp);
+            c.column.swap(pending_.front().column);
+            pending_.pop_front();
+
+            lock.unlock();
+            writeChunk(c);
+            lock.lock();
+        }
+        if (stop_)
+            break;
+    }
+}
+
+void
+dataset_writer::writeChunk(const chunk &c)
+{
+    dataset_index_entry entry;
+    entry.offset = (uint64_t)ftell(file_);
+    entry.rows = c.rows;
+    entry.reserved = 0;
+    entry.t_first = c.stamp[0];
+    entry.t_last = c.stamp[c.rows - 1];
+
+    dataset_chunk_header header;
+    memcpy(header.magic, "CHNK", 4);
+    header.rows = c.rows;
+    header.t_first = entry.t_first;
+    header.t_last = entry.t_last;
+    fwrite(&header, sizeof(header), 1, file_);
+
+    //A partial (last) chunk still uses chunk_rows_ strided columns in memory
+    size_t stride = c.stamp.size();
+    fwrite(&c.stamp[0], sizeof(uint64_t), c.rows, file_);
+    for (int col = 0; col < DS_CHANNEL_COUNT * DS_DOF; col++)
+        fwrite(&c.column[col * stride], sizeof(int16_t), c.rows, file_);
+
+    size_t written = c.rows * sizeof(uint64_t) + (size_t)DS_CHANNEL_COUNT * DS_DOF * c.rows * sizeof(int16_t);
+    static const uint8_t pad[8] = { 0 };
+    fwrite(pad, 1, chunk_payload_size(c.rows) - written, file_);
+    fflush(file_);
+
+    index_.push_back(entry);
+}
+
+////////////////////////////////////////////////////
+//READER
+////////////////////////////////////////////////////
+
+dataset_reader::dataset_reader():
+    data_(NULL),
+    size_(0)
+{
+    memset(&header_, 0, sizeof(header_));
+}
+
+dataset_reader::~dataset_reader()
+{
+    close();
+}
+
+bool
+dataset_reader::open(const std::string &path)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(dataset_file_header))
+    {
+        ::close(fd);
+        return false;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+        return false;
+    data_ = (const uint8_t *)map;
+    size_ = st.st_size;
+
+    memcpy(&header_, data_, sizeof(header_));
+    if (memcmp(header_.magic, "IHDS", 4) != 0 || header_.dof != DS_DOF || header_.channels != DS_CHANNEL_COUNT)
+    {
+        close();
+        return false;
+    }
+
+    dataset_footer footer;
+    if (size_ >= sizeof(header_) + sizeof(footer))
+    {
+        memcpy(&footer, data_ + size_ - sizeof(footer), sizeof(footer));
+        if (memcmp(footer.magic, "IDX1", 4) == 0
+                && footer.index_offset + (uint64_t)footer.chunk_count * sizeof(dataset_index_entry) + sizeof(footer) == size_)
+        {
+            index_.resize(footer.chunk_count);
+            if (footer.chunk_count > 0)
+                memcpy(&index_[0], data_ + footer.index_offset, footer.chunk_count * sizeof(dataset_index_entry));
+            return true;
+        }
+    }
+
+    //No index: the writer was killed, recover every complete chunk
+    return scanChunks();
+}
+
+bool
+dataset_reader::scanChunks()
+{
+    index_.clear();
+    size_t offset = sizeof(dataset_file_header);
+    while (offset + sizeof(dataset_chunk_header) <= size_)
+    {
+        dataset_chunk_header header;
+        memcpy(&header, data_ + offset, sizeof(header));
+        if (memcmp(header.magic, "CHNK", 4) != 0 || header.rows == 0)
+            break;
+        size_t end = offset + sizeof(header) + chunk_payload_size(header.rows);
+        if (end > size_)
+            break;
+
+        dataset_index_entry entry;
+        entry.offset = offset;
+        entry.rows = header.rows;
+        entry.reserved = 0;
+        entry.t_first = header.t_first;
+        entry.t_last = header.t_last;
+        index_.push_back(entry);
+        offset = end;
+    }
+    return true;
+}
+
+void
+dataset_reader::close()
+{
+    if (data_ != NULL)
+        munmap((void *)data_, size_);
+    data_ = NULL;
+    size_ = 0;
+    index_.clear();
+}
+
+uint64_t
+dataset_reader::rows() const
+{
+    uint64_t rows = 0;
+    for (size_t i = 0; i < index_.size(); i++)
+        rows += index_[i].rows;
+    return rows;
+}
+
+const uint64_t *
+dataset_reader::chunkStamps(size_t i) const
+{
+    return (const uint64_t *)(data_ + index_[i].offset + sizeof(dataset_chunk_header));
+}
+
+const int16_t *
+dataset_reader::chunkColumn(size_t i, int channel, int dof) const
+{
+    const uint8_t *columns = (const uint8_t *)(chunkStamps(i) + index_[i].rows);
+    return (const int16_t *)columns + (size_t)(channel * DS_DOF + dof) * index_[i].rows;
+}
+
+size_t
+dataset_reader::slice(uint64_t t0, uint64_t t1, dataset_slice &out) const
+{
+    out.stamp.clear();
+    for (int c = 0; c < DS_CHANNEL_COUNT; c++)
+        for (int d = 0; d < DS_DOF; d++)
+            out.column[c][d].clear();
+
+    //Chunks are in time order, skip straight to the first one that can overlap
+    size_t first = 0, last = index_.size();
+    while (first < last)
+    {
+        size_t mid = (first + last) / 2;
+        if (index_[mid].t_last < t0)
+            first = mid + 1;
+        else
+            last = mid;
+    }
+
+    for (size_t i = first; i < index_.size() && index_[i].t_first < t1; i++)
+    {
+        const uint64_t *stamp = chunkStamps(i);
+        const uint64_t *end = stamp + index_[i].rows;
+        size_t lo = std::lower_bound(stamp, end, t0) - stamp;
+        size_t hi = std::lower_bound(stamp, end, t1) - stamp;
+        if (lo >= hi)
+            continue;
+
+        out.stamp.insert(out.stamp.end(), stamp + lo, stamp + hi);
+        for (int c = 0; c < DS_CHANNEL_COUNT; c++)
+        {
+            for (int d = 0; d < DS_DOF; d++)
+            {
+                const int16_t *col = chunkColumn(i, c, d);
+                out.column[c][d].insert(out.column[c][d].end(), col + lo, col + hi);
+            }
+        }
+    }
+    return out.stamp.size();
+}
+}
@@ -0,0 +1,97 @@
+#include <frame_parser.h>
+
+namespace inspire_hand
+{
+
+frame_parser::frame_parser(uint8_t head0, uint8_t head1):
+    head0_(head0),
+    head1_(head1),
+    head_(0),
+    tail_(0),
+    in_garbage_(false),
+    frames_(0),
+    checksum_errors_(0),
+    resyncs_(0),
+    skipped_bytes_(0),
+    overflows_(0)
+{
+}
+
+void
+frame_parser::push(const uint8_t *data, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        if (tail_ - head_ == RING_SIZE)
+        {
+            head_++;
+            overflows_++;
+        }
+        ring_[tail_ & (RING_SIZE - 1)] = data[i];
+        tail_++;
+    }
+}
+
+void
+frame_parser::skip(size_t count)
+{
+    if (!in_garbage_)
+        resyncs_++;
+    in_garbage_ = true;
+    skipped_bytes_ += count;
+    head_ += count;
+}
+
+bool
+frame_parser::next(std::vector<uint8_t> &frame)
+{
+    while (buffered() >= 2)
+    {
+        if (at(0) != head0_ || at(1) != head1_)
+        {
+            skip(1);
+            continue;
+        }
+        if (buffered() < 4)
+            return false;
+
+        //cmd and address are always there, anything shorter is a false header
+        size_t len = at(3);
+        if (len < 3)
+        {
+            skip(1);
+            continue;
+        }
+        size_t size = len + 5;
+        if (buffered() < size)
+            return false;
+
+        unsigned int check_num = 0;
+        for (size_t i = 2; i < size - 1; i++)
+            check_num += at(i);
+        if ((check_num & 0xff) != at(size - 1))
+        {
+            //Could be a header pattern inside data, look for the next one right after it
+            checksum_errors_++;
+            skip(1);
+            continue;
+        }
+
+        frame.resize(size);
+        for (size_t i = 0; i < size; i++)
+            frame[i] = at(i);
+        head_ += size;
+        in_garbage_ = false;
+        frames_++;
+        return true;
+    }
+    return false;
+}
+
+void
+frame_parser::reset()
+{
+    head_ = tail_;
+    in_garbage_ = false;
+}
+}
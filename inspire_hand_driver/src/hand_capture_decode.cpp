@@ -0,0 +1,229 @@
+#include <block_decoder.h>
+#include <frame_parser.h>
+#include <register_map.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <map>
+#include <string>
+#include <vector>
+
+using inspire_hand::block_decoder;
+
+//Read responses carrying one 6 x 16 bit block: 90 EB id len 11 addrL addrH data[12] checksum
+static const size_t FRAME_BYTES = 7 + block_decoder::BLOCK_BYTES + 1;
+
+struct register_capture
+{
+    register_capture(): reg(-1), count(0) {}
+
+    int reg;
+    std::vector<uint8_t> frames;
+    size_t count;
+};
+
+static double
+seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void
+allocate(std::vector<float> (&columns)[block_decoder::DOF], float *(&out)[block_decoder::DOF], size_t count)
+{
+    for (int i = 0; i < block_decoder::DOF; i++)
+    {
+        columns[i].assign(count, 0);
+        out[i] = columns[i].empty() ? NULL : &columns[i][0];
+    }
+}
+
+static bool
+sameBits(std::vector<float> (&a)[block_decoder::DOF], std::vector<float> (&b)[block_decoder::DOF], size_t count)
+{
+    for (int i = 0; i < block_decoder::DOF; i++)
+        if (count > 0 && memcmp(&a[i][0], &b[i][0], count * sizeof(float)) != 0)
+            return false;
+    return true;
+}
+
+//Every path against the scalar reference, over all 65536 bit patterns, signed and unsigned,
+//at strides that put the blocks on every alignment and counts that end in every tail length
+static int
+selfTest()
+{
+    const size_t strides[] = { 12, 13, 16, 20, 33 };
+    const size_t counts[] = { 0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 10923 };
+    int failures = 0;
+    int cases = 0;
+    for (size_t s = 0; s < sizeof(strides) / sizeof(strides[0]); s++)
+        for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+            for (int sign = 0; sign < 2; sign++)
+            {
+                size_t stride = strides[s];
+                size_t count = counts[c];
+                //Exactly as long as the blocks need, so a read past the end shows up under a checker
+                std::vector<uint8_t> data(count > 0 ? (count - 1) * stride + block_decoder::BLOCK_BYTES : 1);
+                uint32_t v = s * 7919 + c * 104729;
+                for (size_t k = 0; k < count; k++)
+                    for (size_t b = 0; b < block_decoder::BLOCK_BYTES; b += 2, v++)
+                    {
+                        data[k * stride + b] = v & 0xff;
+                        data[k * stride + b + 1] = (v >> 8) & 0xff;
+                    }
+
+                std::vector<float> ref_columns[block_decoder::DOF];
+                float *ref[block_decoder::DOF];
+                allocate(ref_columns, ref, count);
+                block_decoder::decodeScalar(&data[0], stride, 0, count, sign, ref);
+
+                for (int p = block_decoder::PATH_SCALAR; p <= block_decoder::bestPath(); p++)
+                {
+                    std::vector<float> columns[block_decoder::DOF];
+                    float *out[block_decoder::DOF];
+                    allocate(columns, out, count);
+                    block_decoder::decode(&data[0], stride, count, sign, out, block_decoder::path(p));
+                    cases++;
+                    if (!sameBits(ref_columns, columns, count))
+                    {
+                        failures++;
+                        printf("MISMATCH %s stride %zu count %zu %s\n", block_decoder::pathName(block_decoder::path(p)),
+                               stride, count, sign ? "signed" : "unsigned");
+                    }
+                }
+            }
+    printf("self test: %d cases, %d mismatches (best path %s)\n", cases, failures,
+           block_decoder::pathName(block_decoder::bestPath()));
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//Decode a raw capture of the bytes the hand sent; every block register read becomes one CSV per register
+//usage: hand_capture_decode <capture> [--csv <prefix>] [--verify] [--path scalar|sse2|avx2]
+//       hand_capture_decode --self-test
+int
+main(int argc, char *argv[])
+{
+    if (argc > 1 && strcmp(argv[1], "--self-test") == 0)
+        return selfTest();
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <capture> [--csv <prefix>] [--verify] [--path scalar|sse2|avx2]\n"
+                        "       %s --self-test\n", argv[0], argv[0]);
+        return(EXIT_FAILURE);
+    }
+
+    std::string prefix;
+    bool verify = false;
+    block_decoder::path path = block_decoder::bestPath();
+    for (int a = 2; a < argc; a++)
+    {
+        if (strcmp(argv[a], "--csv") == 0 && a + 1 < argc)
+            prefix = argv[++a];
+        else if (strcmp(argv[a], "--verify") == 0)
+            verify = true;
+        else if (strcmp(argv[a], "--path") == 0 && a + 1 < argc)
+        {
+            std::string name = argv[++a];
+            path = name == "avx2" ? block_decoder::PATH_AVX2 : name == "sse2" ? block_decoder::PATH_SSE2
+                                                                             : block_decoder::PATH_SCALAR;
+            if (path > block_decoder::bestPath())
+            {
+                fprintf(stderr, "%s: not supported here\n", name.c_str());
+                return(EXIT_FAILURE);
+            }
+        }
+        else
+        {
+            fprintf(stderr, "unknown option %s\n", argv[a]);
+            return(EXIT_FAILURE);
+        }
+    }
+
+    FILE *in = fopen(argv[1], "rb");
+    if (in == NULL)
+    {
+        perror(argv[1]);
+        return(EXIT_FAILURE);
+    }
+
+    //Frames are kept whole and back to back, the decoder walks them at FRAME_BYTES stride
+    std::map<uint16_t, register_capture> captures;
+    inspire_hand::frame_parser parser;
+    std::vector<uint8_t> frame;
+    uint8_t chunk[inspire_hand::frame_parser::RING_SIZE / 2];
+    size_t n;
+    uint64_t total_frames = 0;
+    while ((n = fread(chunk, 1, sizeof(chunk), in)) > 0)
+    {
+        parser.push(chunk, n);
+        while (parser.next(frame))
+        {
+            total_frames++;
+            if (frame.size() != FRAME_BYTES || frame[4] != 0x11)
+                continue;
+            uint16_t addr = frame[5] | (frame[6] << 8);
+            int r = inspire_hand::registerIndex(addr);
+            if (r < 0 || inspire_hand::REGISTER_TABLE[r].addr != addr || inspire_hand::REGISTER_TABLE[r].width != 2 ||
+                inspire_hand::REGISTER_TABLE[r].count != block_decoder::DOF)
+                continue;
+            register_capture &capture = captures[addr];
+            capture.reg = r;
+            capture.frames.insert(capture.frames.end(), frame.begin(), frame.end());
+            capture.count++;
+        }
+    }
+    fclose(in);
+    printf("%llu frames, %u checksum errors, %u bytes skipped\n", (unsigned long long)total_frames,
+           parser.checksumErrors(), parser.skippedBytes());
+
+    int status = EXIT_SUCCESS;
+    for (std::map<uint16_t, register_capture>::iterator it = captures.begin(); it != captures.end(); ++it)
+    {
+        const register_capture &capture = it->second;
+        const inspire_hand::register_info &info = inspire_hand::REGISTER_TABLE[capture.reg];
+        const uint8_t *data = &capture.frames[7];
+
+        std::vector<float> columns[block_decoder::DOF];
+        float *out[block_decoder::DOF];
+        allocate(columns, out, capture.count);
+        double start = seconds();
+        block_decoder::decode(data, FRAME_BYTES, capture.count, info.is_signed, out, path);
+        double elapsed = seconds() - start;
+        printf("%-10s %zu blocks, %s %.3f ms (%.0f MB/s of frames)\n", info.name, capture.count,
+               block_decoder::pathName(path), elapsed * 1e3,
+               elapsed > 0 ? capture.frames.size() / elapsed / 1e6 : 0.0);
+
+        if (verify)
+        {
+            std::vector<float> ref_columns[block_decoder::DOF];
+            float *ref[block_decoder::DOF];
+            allocate(ref_columns, ref, capture.count);
+            block_decoder::decodeScalar(data, FRAME_BYTES, 0, capture.count, info.is_signed, ref);
+            bool same = sameBits(ref_columns, columns, capture.count);
+            printf("%-10s %s\n", info.name, same ? "matches scalar" : "DIFFERS FROM SCALAR");
+            if (!same)
+                status = EXIT_FAILURE;
+        }
+
+        if (!prefix.empty())
+        {
+            std::string path_name = prefix + "_" + info.name + ".csv";
+            FILE *csv = fopen(path_name.c_str(), "w");
+            if (csv == NULL)
+            {
+                perror(path_name.c_str());
+                return(EXIT_FAILURE);
+            }
+            fprintf(csv, "block,v0,v1,v2,v3,v4,v5\n");
+            for (size_t k = 0; k < capture.count; k++)
+                fprintf(csv, "%zu,%.0f,%.0f,%.0f,%.0f,%.0f,%.0f\n", k,
+                        out[0][k], out[1][k], out[2][k], out[3][k], out[4][k], out[5][k]);
+            fclose(csv);
+        }
+    }
+    return status;
+}
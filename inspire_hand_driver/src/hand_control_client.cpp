@@ -30,6 +30,7 @@
 
 #include <cstdlib>
 #include "hand_control.h"
+#include "state_logger.h"
 //#include <vector>
 #include <fstream>
 #include <iostream>
@@ -62,23 +63,19 @@ int main(int argc, char **argv)
     int i =0;
     std::vector<float> joint_pos(6);
 
-    ofstream outfile0;
-    ofstream outfile1;
-    ofstream outfile2;
-    ofstream outfile3;
-    ofstream outfile4;
-    ofstream outfile5;
-    ofstream outfile_time_force;
+    //Force samples go to a binary log written by a background thread,
+    //convert with: rosrun inspire_hand hand_log_to_csv force_log.bin
+    std::string log_file;
+    ros::NodeHandle("~").param<std::string>("log_file", log_file, "force_log.bin");
+    inspire_hand::state_logger logger;
+    if (!logger.open(log_file))
+    {
+        ROS_ERROR_STREAM("cannot open " << log_file);
+        return 1;
+    }
 
     //  ofstream outfile_time;
     //  ofstream outfile_plan;
-    outfile0.open("/home/wukong/inspire_robot_test/src/data/0_force.txt");
-    outfile1.open("/home/wukong/inspire_robot_test/src/data/1_force.txt");
-    outfile2.open("/home/wukong/inspire_robot_test/src/data/2_force.txt");
-    outfile3.open("/home/wukong/inspire_robot_test/src/data/3_force.txt");
-    outfile4.open("/home/wukong/inspire_robot_test/src/data/4_force.txt");
-    outfile5.open("/home/wukong/inspire_robot_test/src/data/force_set.txt");
-    outfile_time_force.open("/home/wukong/inspire_robot_test/src/data/time_force.txt");
 
     //  outfile_time.open("/home/wukong/inspire_robot_test/src/data/time.txt");
     //  outfile_plan.open("/home/wukong/inspire_robot_test/src/data/0_plan.txt");
@@ -188,14 +185,7 @@ int main(int argc, char **argv)
     //fingers force test
     while(ros::ok()){
         if(client4.call(srv_getforce_act)){
-
-            outfile0<<srv_getforce_act.response.curforce[0]<<endl;
-            outfile1<<srv_getforce_act.response.curforce[1]<<endl;
-            outfile2<<srv_getforce_act.response.curforce[2]<<endl;
-            outfile3<<srv_getforce_act.response.curforce[3]<<endl;
-            outfile4<<srv_getforce_act.response.curforce[4]<<endl;
-            outfile_time_force<<ros::Time::now()<<endl;
-            ROS_INFO("WRITE OK");
+            logger.log(inspire_hand::LOG_FORCE_ACT, &srv_getforce_act.response.curforce[0]);
         }
         else {
             ROS_INFO("SERVICE GET FORCE NOT CALL");
@@ -207,13 +197,9 @@ int main(int argc, char **argv)
 
     //  outfile_plan.close();
     //  outfile_time.close();
-    outfile0.close();
-    outfile1.close();
-    outfile2.close();
-    outfile3.close();
-    outfile4.close();
-    outfile5.close();
-    outfile_time_force.close();
+    logger.close();
+    if (logger.dropped() > 0)
+        ROS_WARN_STREAM("logger dropped " << logger.dropped() << " samples");
 
 
 
@@ -5,9 +5,15 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <vector>
+#include <algorithm>
 #include <iostream>
 #include <string>
+#include <sstream>
+#include <time.h>
+#include <grp.h>
 
 //#include <std_msgs/String.h>
 /*
@@ -46,287 +52,744 @@ namespace inspire_hand
 
 hand_serial::hand_serial(ros::NodeHandle *nh):
     act_position_(-1),
-    hand_state_(0xff)
+    hand_state_(0xff),
+    commands_applied_(0),
+    commands_out_of_range_(0),
+    command_lag_last_(0),
+    command_lag_max_(0),
+    setpoints_suppressed_(0),
+    setpoint_bytes_(0),
+    poll_count_(0),
+    poll_active_(true),
+    last_angle_valid_(false),
+    poll_rate_changes_(0),
+    poll_cycles_saved_(0),
+    motion_hint_(false),
+    param_nh_(*nh),
+    poll_failures_(0),
+    ready_(false),
+    stopping_(false)
 {
+    bringup_start_ = ros::WallTime::now();
+    health_.state = inspire_hand::HandHealth::STARTING;
+    health_.hand_id = 0;
+    for (int f = 0; f < SP_FIELD_COUNT; f++)
+        invalidateShadow(f);
+    for (int i = 0; i < 6; i++)
+    {
+        cmdangle_[i] = 0;
+        curangle_[i] = 0;
+        curforce_[i] = 0;
+        current_[i] = 0;
+        errorvalue_[i] = 0;
+        statusvalue_[i] = 0;
+        tempvalue_[i] = 0;
+        speed_request_[i] = -1;
+    }
+
     //Read launch file params
     nh->getParam("inspire_hand/hand_id", hand_id_);
     nh->getParam("inspire_hand/portname", port_name_);
     nh->getParam("inspire_hand/baudrate", baudrate_);
     nh->getParam("inspire_hand/test_flags", test_flags);
+    nh->param("inspire_hand/poll_rate", poll_rate_, 50.0);
+    nh->param("inspire_hand/idle_poll_rate", idle_poll_rate_, 5.0);
+    nh->param("inspire_hand/idle_after", idle_after_, 0.5);
+    nh->param("inspire_hand/motion_delta", motion_delta_, 5.0);
+    nh->param("inspire_hand/status_divider", status_divider_, 5);
+    nh->param("inspire_hand/safety_rate", safety_rate_, 2.0);
+    double safety_max_wait, telemetry_max_wait;
+    nh->param("inspire_hand/safety_max_wait", safety_max_wait, 0.05);
+    nh->param("inspire_hand/telemetry_max_wait", telemetry_max_wait, 0.5);
+    bus_scheduler_.setMaxWait(BUS_SAFETY, uint64_t(safety_max_wait * 1e6));
+    bus_scheduler_.setMaxWait(BUS_TELEMETRY, uint64_t(telemetry_max_wait * 1e6));
+    nh->param("inspire_hand/command_timeout", command_timeout_, 0.1);
+    nh->param("inspire_hand/command_lease", command_lease_, 0.5);
+    nh->param("inspire_hand/maintenance_timeout", maintenance_timeout_, 10.0);
+    nh->param("inspire_hand/maintenance_poll", maintenance_poll_, 0.02);
+    nh->param("inspire_hand/response_timeout", response_timeout_, 0.1);
+    nh->param("inspire_hand/retries", retries_, 2);
+    nh->param("inspire_hand/retry_backoff", retry_backoff_, 0.01);
+    nh->param("inspire_hand/degraded_after", degraded_after_, 5);
+    nh->param("inspire_hand/metrics_period", metrics_period_, 10.0);
+    nh->getParam("inspire_hand/metrics_file", metrics_file_);
+    if (retries_ < 0)
+        retries_ = 0;
+    if (status_divider_ < 1)
+        status_divider_ = 1;
+    //An idle rate at or above the active rate turns the adaptation off
+    if (idle_poll_rate_ <= 0 || idle_poll_rate_ >= poll_rate_)
+        idle_poll_rate_ = poll_rate_;
+    last_motion_ = ros::WallTime::now();
+    last_error_read_ = last_motion_;
+    last_temp_read_ = last_motion_;
+
+    //Contact thresholds, either one value for all fingers or one per DOF
+    double contact_onset, contact_release;
+    nh->param("inspire_hand/contact_onset", contact_onset, 100.0);
+    nh->param("inspire_hand/contact_release", contact_release, 50.0);
+    std::vector<double> onsets, releases;
+    nh->getParam("inspire_hand/contact_onsets", onsets);
+    nh->getParam("inspire_hand/contact_releases", releases);
+    for (int i = 0; i < contact_detector::DOF; i++)
+    {
+        contact_.setThreshold(i,
+                              i < (int)onsets.size() ? onsets[i] : contact_onset,
+                              i < (int)releases.size() ? releases[i] : contact_release);
+    }
+
+    //Thermal model, one value for all actuators or one per DOF; thermal_limit <= 0 turns the throttle off
+    double thermal_limit, thermal_gain, thermal_tau, thermal_ambient, thermal_horizon, thermal_min_scale;
+    nh->param("inspire_hand/thermal_limit", thermal_limit, 70.0);
+    nh->param("inspire_hand/thermal_gain", thermal_gain, 20.0);
+    nh->param("inspire_hand/thermal_tau", thermal_tau, 120.0);
+    nh->param("inspire_hand/thermal_ambient", thermal_ambient, 25.0);
+    nh->param("inspire_hand/thermal_horizon", thermal_horizon, 60.0);
+    nh->param("inspire_hand/thermal_min_scale", thermal_min_scale, 0.3);
+    std::vector<double> gains, taus;
+    nh->getParam("inspire_hand/thermal_gains", gains);
+    nh->getParam("inspire_hand/thermal_taus", taus);
+    for (int i = 0; i < thermal_model::DOF; i++)
+    {
+        thermal_.setActuator(i,
+                             i < (int)gains.size() ? gains[i] : thermal_gain,
+                             i < (int)taus.size() ? taus[i] : thermal_tau,
+                             thermal_limit);
+    }
+    thermal_.setAmbient(thermal_ambient);
+    thermal_.setThrottle(thermal_horizon, thermal_min_scale);
+    thermal_.reset();
+    //The model is fed on the TEMP reads of the safety cadence
+    thermal_enabled_ = thermal_limit > 0 && safety_rate_ > 0;
 
     //Initialize and open serial port
+    beginPhase("open_port");
     com_port_ = new serial::Serial(port_name_, (uint32_t)baudrate_, serial::Timeout::simpleTimeout(100));
     if (com_port_->isOpen())
     {
         ROS_INFO_STREAM("Hand: Serial port " << port_name_ << " openned");
-        int id_state = 0;
-        while (1)
-        {
-            id_state = start(com_port_);
-            if (id_state == 1)
-                break;
-            hand_id_++;
-            if (hand_id_ >= 256)
-            {
-                ROS_INFO("Id error!!!");
-                hand_id_ = 1;
-            }
-        }
+        endPhase();
+        //The id scan and the wait for a first valid state can take seconds, services and topics
+        //come up right away and refuse requests until inspire_hand/health reports READY
+        bringup_thread_ = std::thread(&hand_serial::bringUp, this);
+    }
+    else
+    {
+        ROS_ERROR_STREAM("Hand: Serial port " << port_name_ << " not opened");
+        failPhase("cannot open " + port_name_);
+    }
+}
 
-        //Get initial state and discard input buffer
-        while (hand_state_ == 0xff)
+void
+hand_serial::bringUp()
+{
+    beginPhase("id_scan");
+    int id_state = 0;
+    while (!stopping_)
+    {
+        id_state = start(com_port_);
+        if (id_state == 1)
+            break;
+        hand_id_++;
+        if (hand_id_ >= 256)
         {
-            //hand_state_ = 0x01;
-            hand_state_ = getERROR(com_port_);
-            ros::Duration(WAIT_FOR_RESPONSE_INTERVAL).sleep();
+            ROS_INFO("Id error!!!");
+            hand_id_ = 1;
         }
+    }
 
-        //Start periodic hand state reading
-        //getPeriodicPositionUpdate(com_port_, TF_UPDATE_PERIOD);
-
-        /*ros::Publisher chatter_pub = nh->advertise<std_msgs::Int32MultiArray>("chatter", 1000);
-                        ros::Subscriber sub = nh->subscribe("chatter", 1000, arrayCallback);
-                        ros::Rate loop_rate(10000);
-                        while (ros::ok())
-                        {
+    if (stopping_)
+        return;
+    endPhase();
 
-                                std_msgs::Int32MultiArray array;
-                                //Clear array
-                                array.data.clear();
-                                getANGLE_ACT(com_port_);
-                                getFORCE_ACT(com_port_);
+    //Get initial state and discard input buffer
+    beginPhase("initial_state");
+    while (hand_state_ == 0xff && !stopping_)
+    {
+        //hand_state_ = 0x01;
+        hand_state_ = getERROR(com_port_);
+        ros::Duration(WAIT_FOR_RESPONSE_INTERVAL).sleep();
+    }
+    if (stopping_)
+        return;
+    endPhase();
+
+    //Start periodic hand state reading
+    //getPeriodicPositionUpdate(com_port_, TF_UPDATE_PERIOD);
+
+    /*ros::Publisher chatter_pub = nh->advertise<std_msgs::Int32MultiArray>("chatter", 1000);
+                    ros::Subscriber sub = nh->subscribe("chatter", 1000, arrayCallback);
+                    ros::Rate loop_rate(10000);
+                    while (ros::ok())
+                    {
+
+                            std_msgs::Int32MultiArray array;
+                            //Clear array
+                            array.data.clear();
+                            getANGLE_ACT(com_port_);
+                            getFORCE_ACT(com_port_);
+
+
+                            for (int i = 0; i <6; i++)
+                            {
+                                    //assign array a random number between 0 and 255.
+                                    array.data.push_back(curangle_[i]);
+
+                            }
+
+                            for (int i = 0; i <6; i++)
+                            {
+                                    //assign array a random number between 0 and 255.
+                                    array.data.push_back(curforce_[i]);
+
+                            }
+                            //Publish array
+                            chatter_pub.publish(array);
+                            //Let the world know
+                            ROS_INFO("I published something!");
+                            //Do this.
+                            ros::spinOnce();
+
+                            loop_rate.sleep();
+                    }*/
+
+    //Provisioning profile, saved to flash only when the hand did not already hold it
+    std::string profile_name;
+    param_nh_.getParam("inspire_hand/profile", profile_name);
+    if (!profile_name.empty())
+    {
+        beginPhase("profile");
+        config_profile profile;
+        int written;
+        bool saved;
+        if (!loadProfile(profile_name, profile))
+            ROS_ERROR_STREAM("Hand: profile " << profile_name << " not found or invalid");
+        else if (applyProfile(com_port_, profile, true, written, saved))
+            ROS_INFO_STREAM("Hand: profile " << profile_name << " applied, " << written << " registers written"
+                            << (saved ? ", saved to flash" : ""));
+        else
+            ROS_ERROR_STREAM("Hand: applying profile " << profile_name << " failed");
+        endPhase();
+    }
 
+    //Opened after the id scan so files carry the id actually in use
+    std::string log_file;
+    param_nh_.getParam("inspire_hand/log_file", log_file);
+    if (!log_file.empty())
+    {
+        if (logger_.open(log_file, hand_id_))
+            ROS_INFO_STREAM("Hand: logging state to " << log_file);
+        else
+            ROS_ERROR_STREAM("Hand: cannot open log file " << log_file);
+    }
 
-                                for (int i = 0; i <6; i++)
-                                {
-                                        //assign array a random number between 0 and 255.
-                                        array.data.push_back(curangle_[i]);
+    std::string dataset_dir;
+    int chunk_rows;
+    param_nh_.getParam("inspire_hand/dataset_dir", dataset_dir);
+    param_nh_.param("inspire_hand/dataset_chunk_rows", chunk_rows, 1024);
+    param_nh_.param("inspire_hand/dataset_temp_divider", dataset_temp_divider_, 10);
+    if (dataset_temp_divider_ < 1)
+        dataset_temp_divider_ = 1;
+    if (!dataset_dir.empty())
+    {
+        //Seed the commanded column with the targets the hand already holds
+        getANGLE_SET(com_port_);
+        {
+            std::lock_guard<std::mutex> lock(setpoint_mutex_);
+            for (int i = 0; i < 6; i++)
+                cmdangle_[i] = setangle_[i];
+        }
 
-                                }
+        char name[64];
+        time_t now = time(NULL);
+        strftime(name, sizeof(name), "%Y%m%d_%H%M%S", localtime(&now));
+        std::string path = dataset_dir + "/hand" + std::to_string(hand_id_) + "_" + name + ".ihds";
+        if (dataset_.open(path, hand_id_, chunk_rows))
+            ROS_INFO_STREAM("Hand: exporting dataset to " << path);
+        else
+            ROS_ERROR_STREAM("Hand: cannot open dataset file " << path);
+    }
 
-                                for (int i = 0; i <6; i++)
-                                {
-                                        //assign array a random number between 0 and 255.
-                                        array.data.push_back(curforce_[i]);
+    std::string shm_name;
+    param_nh_.getParam("inspire_hand/shm_name", shm_name);
+    if (!shm_name.empty())
+    {
+        if (shm_.open(shm_name))
+            ROS_INFO_STREAM("Hand: exporting state to shared memory " << shm_name);
+        else
+            ROS_ERROR_STREAM("Hand: cannot create shared memory " << shm_name);
+    }
 
-                                }
-                                //Publish array
-                                chatter_pub.publish(array);
-                                //Let the world know
-                                ROS_INFO("I published something!");
-                                //Do this.
-                                ros::spinOnce();
+    int history_size = 0;
+    param_nh_.param("inspire_hand/history_size", history_size, 0);
+    if (history_size > 0)
+    {
+        std::lock_guard<std::mutex> lock(history_mutex_);
+        if (history_.allocate(history_size))
+            ROS_INFO("Hand: keeping the last %d samples in memory", int(history_.capacity()));
+        else
+            ROS_ERROR("Hand: cannot allocate a history of %d samples", history_size);
+    }
 
-                                loop_rate.sleep();
-                        }*/
+    ready_ = true;
+    {
+        std::lock_guard<std::mutex> lock(health_mutex_);
+        health_.state = inspire_hand::HandHealth::READY;
+        health_.hand_id = hand_id_;
+        health_.phase = "";
+        health_.detail = "";
     }
-    else
-        ROS_ERROR_STREAM("Hand: Serial port " << port_name_ << " not opened");
+    ROS_INFO_STREAM("Hand: ready, bring-up took " << (ros::WallTime::now() - bringup_start_).toSec() << " s");
+    publishHealth();
 }
 
-hand_serial::~hand_serial()
+void
+hand_serial::beginPhase(const std::string &phase)
 {
-    com_port_->close();      //Close port
-    delete com_port_;        //delete object
+    {
+        std::lock_guard<std::mutex> lock(health_mutex_);
+        health_.phase = phase;
+        health_.detail = "";
+    }
+    phase_start_ = ros::WallTime::now();
+    publishHealth();
 }
 
-int
-hand_serial::start(serial::Serial *port)
+void
+hand_serial::endPhase()
 {
+    double took = (ros::WallTime::now() - phase_start_).toSec();
+    std::lock_guard<std::mutex> lock(health_mutex_);
+    ROS_INFO_STREAM("Hand: " << health_.phase << " took " << took << " s");
+    health_.phase_names.push_back(health_.phase);
+    health_.phase_durations.push_back(took);
+}
 
-    std::vector<uint8_t> output;
-    output.push_back(0xEB);
-    output.push_back(0x90);
-    output.push_back(hand_id_);
-    output.push_back(0x04);
-    output.push_back(0x11);
-    output.push_back(0xFE);
-    output.push_back(0x05);
-    output.push_back(0x0C);
-
-    unsigned int check_num = 0;
-
-    int len = output[3] + 5;
-    for (int i = 2; i < len - 1; i++)
-        check_num = check_num + output[i];
+void
+hand_serial::failPhase(const std::string &detail)
+{
+    {
+        std::lock_guard<std::mutex> lock(health_mutex_);
+        health_.state = inspire_hand::HandHealth::FAILED;
+        health_.detail = detail;
+    }
+    publishHealth();
+}
 
-    //Add checksum to the output buffer
-    output.push_back(check_num & 0xff);
+void
+hand_serial::publishHealth()
+{
+    //Before advertise() there is no publisher yet, advertise() sends the state it finds
+    std::lock_guard<std::mutex> lock(health_mutex_);
+    if (!health_pub)
+        return;
+    health_.stamp = ros::Time::now();
+    health_.hand_id = hand_id_;
+    health_pub.publish(health_);
+}
 
-    //Send message to the module and wait for response
-    port->write(output);
+hand_serial::~hand_serial()
+{
+    stopping_ = true;
+    if (maintenance_server_)
+        maintenance_server_->shutdown();
+    if (bringup_thread_.joinable())
+        bringup_thread_.join();
+    if (io_thread_.joinable())
+        io_thread_.join();
+    if (command_thread_.joinable())
+        command_thread_.join();
+    //Release everything bound to the queues while their threads are gone and the queues still exist
+    command_sub_.shutdown();
+    poll_timer_.shutdown();
+    stats_timer_.shutdown();
+    shm_command_timer_.shutdown();
+    if (logger_.dropped() > 0)
+        ROS_WARN_STREAM("Hand: state logger dropped " << logger_.dropped() << " samples");
+    logger_.close();
+    dataset_.close();
+    shm_.close();
+    command_shm_.close();
+    com_port_->close();      //Close port
+    delete com_port_;        //delete object
+}
 
-    ros::Duration(0.015).sleep();
+transaction_result
+hand_serial::transaction(serial::Serial *port, std::vector<uint8_t> &output, std::vector<uint8_t> &input, double wait)
+{
+    //The whole request/response exchange holds the bus, frames of different callers never interleave.
+    //Who gets it next is up to the scheduler, not to whoever asked first
+    bus_grant grant(bus_scheduler_, busClassOf(output));
+    std::lock_guard<std::mutex> lock(bus_mutex_);
+
+    appendChecksum(output);
+    uint16_t addr = output[5] | (output[6] << 8);
+
+    ros::WallTime start = ros::WallTime::now();
+    std::vector<std::vector<uint8_t> > requests(1, output);
+    std::vector<std::vector<uint8_t> > responses;
+    transaction_result result = TR_TIMEOUT;
+    int attempt = 0;
+    for (; attempt <= retries_; attempt++)
+    {
+        if (attempt > 0)
+        {
+            //Back off before each retry, doubling the pause every time
+            bus_stats_.retries++;
+            ros::Duration(retry_backoff_ * (1 << (attempt - 1))).sleep();
+        }
+        result = exchange(port, requests, responses, wait);
+        if (result == TR_OK)
+            break;
+    }
+    double held = (ros::WallTime::now() - start).toSec();
+    recordTransaction((uint32_t(output[4]) << 16) | addr, held, result, attempt > retries_ ? retries_ : attempt);
+
+    bus_stats_.transactions++;
+    bus_stats_.busy_time += held;
+    if (isMotionWrite(output))
+        motion_hint_ = true;
+    if (result != TR_OK)
+    {
+        countFailure(result);
+        bus_stats_.register_errors[addr]++;
+        ROS_WARN_THROTTLE(1.0, "Hand: no valid response for register 0x%04X after %d attempts", addr, retries_ + 1);
+        input.clear();
+        return result;
+    }
+    //Callers read the data at fixed offsets of a complete, validated frame
+    input.swap(responses[0]);
+    return result;
+}
 
-    //Read response
-    std::vector<uint8_t> input;
-    port->read(input, (size_t)64);
-    //ROS_INFO("ok");
-    if (input.empty())
-        return 0;
+void
+hand_serial::countFailure(transaction_result result)
+{
+    //Silence, a garbled answer and a cut off one point at different faults (wiring, noise, baud rate)
+    if (result == TR_CORRUPT)
+        bus_stats_.corrupt++;
+    else if (result == TR_SHORT_FRAME)
+        bus_stats_.short_frames++;
     else
-        return 1;
+        bus_stats_.timeouts++;
 }
-bool
-hand_serial::setID(serial::Serial *port,int id)
-{
-    std::vector<uint8_t> output;
-    //message from master to module
-    output.push_back(0xEB);
-    output.push_back(0x90);
-    //module id
-    output.push_back(hand_id_);
-    //Data Length
-    output.push_back(0x04);
-    //Command get state
-    output.push_back(0x12);
-    output.push_back(0xE8);
-    output.push_back(0x03);
-
-    unsigned int temp_int2;
-    temp_int2 = (unsigned int)id;
-    hand_id_ = id;
-    output.push_back(temp_int2);
-    //Checksum calculation
-
-    unsigned int check_num = 0;
-    int len = output[3] + 5;
-    for (int i = 2; i < len - 1; i++)
-        check_num = check_num + output[i];
-    //Add checksum to the output buffer
-    output.push_back(check_num & 0xff);
 
+void
+hand_serial::recordTransaction(uint32_t key, double seconds, transaction_result result, int retries)
+{
+    std::lock_guard<std::mutex> lock(metrics_mutex_);
+    op_metrics &m = register_metrics_[key];
+    m.latency.record(uint64_t(seconds * 1e6));
+    m.retries += retries;
+    switch (result)
+    {
+    case TR_OK:
+        m.ok++;
+        break;
+    case TR_TIMEOUT:
+        m.timeout++;
+        break;
+    case TR_SHORT_FRAME:
+        m.short_frame++;
+        break;
+    case TR_CORRUPT:
+        m.corrupt++;
+        break;
+    }
+}
 
-    //Send message to the module
-    port->write(output);
+void
+hand_serial::recordService(const std::string &name, double seconds, bool ok)
+{
+    std::lock_guard<std::mutex> lock(metrics_mutex_);
+    op_metrics &m = service_metrics_[name];
+    m.latency.record(uint64_t(seconds * 1e6));
+    if (ok)
+        m.ok++;
+    else
+        m.failed++;
+}
 
-    ros::Duration(0.015).sleep();
+std::string
+hand_serial::operationName(uint32_t key)
+{
+    if (key == OP_BATCH)
+        return "write batch";
+
+    uint8_t cmd = key >> 16;
+    uint16_t addr = key & 0xffff;
+    std::string name = cmd == 0x11 ? "read " : "write ";
+    int r = registerIndex(addr);
+    if (r >= 0 && addr == REGISTER_TABLE[r].addr)
+        return name + REGISTER_TABLE[r].name;
+    char hex[16];
+    //Writes starting inside a register carry the element they start at
+    if (r >= 0)
+    {
+        sprintf(hex, "[%d]", (addr - REGISTER_TABLE[r].addr) / REGISTER_TABLE[r].width);
+        return name + REGISTER_TABLE[r].name + hex;
+    }
+    sprintf(hex, "0x%04X", addr);
+    return name + hex;
+}
 
-    std::string s1;
-    for (int i = 0; i<output.size(); ++i)
+void
+hand_serial::metricsTimerCallback(const ros::TimerEvent &event)
+{
+    //Snapshot under the lock, formatting and file I/O happen without it
+    std::vector<std::pair<std::string, op_metrics> > ops;
     {
-        char str[16];
-        sprintf(str, "%02X", output[i]);
-        s1 = s1 + str + " ";
+        std::lock_guard<std::mutex> lock(metrics_mutex_);
+        for (std::map<uint32_t, op_metrics>::iterator it = register_metrics_.begin(); it != register_metrics_.end(); ++it)
+        {
+            ops.push_back(std::make_pair(operationName(it->first), it->second));
+            it->second.reported_failures = it->second.failures();
+        }
+        for (std::map<std::string, op_metrics>::iterator it = service_metrics_.begin(); it != service_metrics_.end(); ++it)
+        {
+            ops.push_back(std::make_pair("service " + it->first, it->second));
+            it->second.reported_failures = it->second.failures();
+        }
     }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Write: " << s1);
 
-    std::vector<uint8_t> input;
-    while (input.empty()) {
-        port->read(input, (size_t)64);
+    static const double QUANTILES[5] = { 50, 90, 99, 99.9, 100 };
+    static const char *QUANTILE_NAMES[5] = { "p50_us", "p90_us", "p99_us", "p999_us", "max_us" };
+    std::string hardware_id = "inspire_hand_" + std::to_string(hand_id_);
+
+    diagnostic_msgs::DiagnosticArrayPtr array(new diagnostic_msgs::DiagnosticArray);
+    array->header.stamp = ros::Time::now();
+    std::ostringstream file;
+    file << "# inspire_hand metrics, hand " << hand_id_ << ", " << array->header.stamp.toSec() << "\n";
+    for (size_t i = 0; i < ops.size(); ++i)
+    {
+        const op_metrics &m = ops[i].second;
+        diagnostic_msgs::DiagnosticStatus status;
+        status.name = "inspire_hand: " + ops[i].first;
+        status.hardware_id = hardware_id;
+        //Warn while new failures keep coming in, back to OK after a quiet period
+        bool failing = m.failures() != m.reported_failures;
+        status.level = failing ? diagnostic_msgs::DiagnosticStatus::WARN : diagnostic_msgs::DiagnosticStatus::OK;
+        status.message = failing ? "failures since last report" : "ok";
+
+        std::vector<std::pair<std::string, uint64_t> > values;
+        values.push_back(std::make_pair("count", m.latency.count()));
+        values.push_back(std::make_pair("ok", m.ok));
+        values.push_back(std::make_pair("timeout", m.timeout));
+        values.push_back(std::make_pair("short", m.short_frame));
+        values.push_back(std::make_pair("corrupt", m.corrupt));
+        values.push_back(std::make_pair("retry", m.retries));
+        values.push_back(std::make_pair("failed", m.failed));
+        values.push_back(std::make_pair("min_us", m.latency.min()));
+        for (int q = 0; q < 5; q++)
+            values.push_back(std::make_pair(QUANTILE_NAMES[q], m.latency.percentile(QUANTILES[q])));
+
+        file << "op=\"" << ops[i].first << "\"";
+        for (size_t v = 0; v < values.size(); ++v)
+        {
+            diagnostic_msgs::KeyValue kv;
+            kv.key = values[v].first;
+            kv.value = std::to_string(values[v].second);
+            status.values.push_back(kv);
+            file << " " << values[v].first << "=" << values[v].second;
+        }
+        file << "\n";
+        array->status.push_back(status);
     }
+    diagnostics_pub.publish(array);
 
-    std::string s2;
-    for (int i = 0; i<input.size(); ++i)
+    if (metrics_file_.empty())
+        return;
+    //Write and rename, a reader never sees a half written file
+    std::string tmp = metrics_file_ + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "w");
+    if (f == NULL)
     {
-        char str[16];
-        sprintf(str, "%02X", input[i]);
-        s2 = s2 + str + " ";
+        ROS_WARN_STREAM_THROTTLE(60, "Hand: cannot write metrics file " << tmp);
+        return;
     }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Read: " << s2);
-    int temp[10] = { 0 };
-    for (int j = 0; j<1; j++)
-        temp[j] = input[7];
-    if (temp[0] == 1)
-        return true;
-    else
-        return false;
+    std::string text = file.str();
+    fwrite(text.data(), 1, text.size(), f);
+    fclose(f);
+    rename(tmp.c_str(), metrics_file_.c_str());
 }
+
 bool
-hand_serial::setREDU_RATIO(serial::Serial *port,int redu_ratio)
+hand_serial::answers(const std::vector<uint8_t> &request, const std::vector<uint8_t> &response)
 {
-    std::vector<uint8_t> output;
-    //message from master to module
-    output.push_back(0xEB);
-    output.push_back(0x90);
-    //module redu_ratio
-    output.push_back(hand_id_);
-    //Data Length
-    output.push_back(0x04);
-    //Command get state
-    output.push_back(0x12);
-    output.push_back(0xE9);
-    output.push_back(0x03);
-
-    unsigned int temp_int2;
-    temp_int2 = (unsigned int)redu_ratio;
-
-    if (redu_ratio == 0)
-        baudrate_ = 115200;
-    else if (redu_ratio == 1)
-        baudrate_ = 57600;
-    else
-        baudrate_ = 19200;
-    output.push_back(temp_int2);
-    //Checksum calculation
-
-    unsigned int check_num = 0;
-    int len = output[3] + 5;
-
+    //Same id, command and address; a read answer must carry the requested byte count.
+    //A write to ID goes to the old id and may be answered from the new one
+    bool id_write = request[4] == 0x12 && (request[5] | (request[6] << 8)) == reg::ID::addr;
+    if (response[2] != request[2] && !(id_write && response[2] == request[7]))
+        return false;
+    if (response[4] != request[4] || response[5] != request[5] || response[6] != request[6])
+        return false;
+    if (request[4] == 0x11)
+        return response[3] == 3 + request[7];
+    return true;
+}
 
-    for (int i = 2; i < len - 1; i++)
-        check_num = check_num + output[i];
-    //Add checksum to the output buffer
-    output.push_back(check_num & 0xff);
+transaction_result
+hand_serial::exchange(serial::Serial *port, const std::vector<std::vector<uint8_t> > &requests,
+                      std::vector<std::vector<uint8_t> > &responses, double wait)
+{
+    //Late bytes of an earlier, timed out exchange must not be taken for this response
+    port->flushInput();
+    parser_.reset();
 
-    //Send message to the module
+    //All requests go out in one write, the module answers them in order
+    std::vector<uint8_t> output;
+    for (size_t i = 0; i < requests.size(); ++i)
+        output.insert(output.end(), requests[i].begin(), requests[i].end());
     port->write(output);
+    //The answer is read as soon as it is complete, wait only stretches the deadline for a slow
+    //request; it is counted from the write, not slept on top of it
+    ros::WallTime deadline = ros::WallTime::now() + ros::WallDuration(std::max(wait, response_timeout_));
 
-    ros::Duration(0.015).sleep();
+    if (test_flags == 1)
+        ROS_INFO_STREAM("Write: " << hexString(output));
+
+    //Feed whatever arrives to the parser until every request has its answer or the deadline passes
+    responses.assign(requests.size(), std::vector<uint8_t>());
+    size_t answered = 0;
+    uint32_t checksum_errors = parser_.checksumErrors();
+    size_t received = 0;
+    std::vector<uint8_t> chunk;
+    std::vector<uint8_t> frame;
+    //A read waiting for the first byte gives up when the deadline does, not after the port's own timeout
+    serial::Timeout port_timeout = port->getTimeout();
+    serial::Timeout read_timeout = port_timeout;
+    ros::WallTime now;
+    while (answered < requests.size() && (now = ros::WallTime::now()) < deadline)
+    {
+        size_t available = port->available();
+        if (available == 0)
+        {
+            read_timeout.read_timeout_constant = uint32_t(ceil((deadline - now).toSec() * 1000.0));
+            port->setTimeout(read_timeout);
+        }
+        chunk.clear();
+        port->read(chunk, available > 0 ? available : 1);
+        if (chunk.empty())
+            continue;
+        received += chunk.size();
+        if (test_flags == 1)
+            ROS_INFO_STREAM("Read: " << hexString(chunk));
+        parser_.push(&chunk[0], chunk.size());
+
+        while (parser_.next(frame))
+        {
+            size_t i = 0;
+            while (i < requests.size() && (!responses[i].empty() || !answers(requests[i], frame)))
+                i++;
+            if (i == requests.size())
+            {
+                //Valid frame, but not for us: another drop on the bus or a stale answer
+                bus_stats_.unmatched++;
+                continue;
+            }
+            responses[i] = frame;
+            answered++;
+        }
+    }
+    port->setTimeout(port_timeout);
 
-    std::string s1;
+    if (answered == requests.size())
+        return TR_OK;
+    if (received == 0)
+        return TR_TIMEOUT;
+    if (parser_.checksumErrors() != checksum_errors)
+        return TR_CORRUPT;
+    return TR_SHORT_FRAME;
+}
 
-    for (int i = 0; i<output.size(); ++i)
+bool
+hand_serial::transactionBatch(serial::Serial *port, std::vector<std::vector<uint8_t> > &frames, double wait, std::vector<bool> &acked)
+{
+    //A batch is scheduled as its most urgent frame
+    int cls = BUS_TELEMETRY;
+    for (size_t i = 0; i < frames.size(); ++i)
     {
-        char str[16];
-        sprintf(str, "%02X", output[i]);
-        s1 = s1 + str + " ";
+        int c = busClassOf(frames[i]);
+        if (c < cls)
+            cls = c;
     }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Write: " << s1);
+    bus_grant grant(bus_scheduler_, cls);
+    std::lock_guard<std::mutex> lock(bus_mutex_);
 
-    std::vector<uint8_t> input;
-    while (input.empty()) {
-        port->read(input, (size_t)64);
+    for (size_t i = 0; i < frames.size(); ++i)
+        appendChecksum(frames[i]);
+
+    //Every write is acknowledged with its own frame, result byte at offset 7.
+    //Setpoint writes are idempotent, a retry simply sends the whole batch again
+    ros::WallTime start = ros::WallTime::now();
+    std::vector<std::vector<uint8_t> > responses;
+    transaction_result result = TR_TIMEOUT;
+    int attempt = 0;
+    for (; attempt <= retries_; attempt++)
+    {
+        if (attempt > 0)
+        {
+            bus_stats_.retries++;
+            ros::Duration(retry_backoff_ * (1 << (attempt - 1))).sleep();
+        }
+        result = exchange(port, frames, responses, wait);
+        if (result == TR_OK)
+            break;
     }
+    double held = (ros::WallTime::now() - start).toSec();
+    recordTransaction(OP_BATCH, held, result, attempt > retries_ ? retries_ : attempt);
 
-    std::string s2;
-    for (int i = 0; i<input.size(); ++i)
+    bool ok = true;
+    bus_stats_.transactions++;
+    bus_stats_.busy_time += held;
+    for (size_t i = 0; i < frames.size(); ++i)
     {
-        char str[16];
-        sprintf(str, "%02X", input[i]);
-        s2 = s2 + str + " ";
+        if (isMotionWrite(frames[i]))
+            motion_hint_ = true;
     }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Read: " << s2);
-    int temp[10] = { 0 };
-    for (int j = 0; j<1; j++)
-        temp[j] = input[7];
-    if (temp[0] == 1)
-        return true;
-    else
-        return false;
+    if (result != TR_OK)
+        countFailure(result);
+    acked.assign(frames.size(), false);
+    for (size_t i = 0; i < frames.size(); ++i)
+    {
+        acked[i] = !responses[i].empty() && responses[i][7] == 1;
+        if (!acked[i])
+        {
+            ok = false;
+            if (responses[i].empty())
+                bus_stats_.register_errors[frames[i][5] | (frames[i][6] << 8)]++;
+        }
+    }
+    return ok;
 }
 
 bool
-hand_serial::setCLEAR_ERROR(serial::Serial *port)
+hand_serial::isMotionWrite(const std::vector<uint8_t> &frame)
 {
-    std::vector<uint8_t> output;
-    //mclear_errorsage from master to module
-    output.push_back(0xEB);
-    output.push_back(0x90);
-    //module id
-    output.push_back(hand_id_);
-    //Data Length
-    output.push_back(0x04);
-    //Command get state
-    output.push_back(0x012);
-    output.push_back(0xEC);
-    output.push_back(0x03);
-    output.push_back(0x01);
+    if (frame.size() < 7 || frame[4] != 0x12)
+        return false;
+    uint16_t addr = frame[5] | (frame[6] << 8);
+    //GESTURE_NO, and POS_SET through SPEED_SET
+    return addr == reg::GESTURE_NO::addr || (addr >= reg::POS_SET::addr && addr < reg::SPEED_SET::end);
+}
+
+int
+hand_serial::busClassOf(const std::vector<uint8_t> &frame)
+{
+    if (isMotionWrite(frame))
+        return BUS_COMMAND;
+    uint16_t addr = frame[5] | (frame[6] << 8);
+    //ERROR, STATUS and TEMP are contiguous
+    if (frame[4] == 0x11 && addr >= reg::ERROR::addr && addr < reg::TEMP::end)
+        return BUS_SAFETY;
+    if (frame[4] == 0x12 && addr == reg::CLEAR_ERROR::addr)
+        return BUS_SAFETY;
+    return BUS_TELEMETRY;
+}
 
+void
+hand_serial::appendChecksum(std::vector<uint8_t> &output)
+{
     //Checksum calculation
     unsigned int check_num = 0;
     int len = output[3] + 5;
@@ -334,1772 +797,813 @@ hand_serial::setCLEAR_ERROR(serial::Serial *port)
         check_num = check_num + output[i];
     //Add checksum to the output buffer
     output.push_back(check_num & 0xff);
-    //Send mclear_errorsage to the module
-    port->write(output);
-    ros::Duration(0.5 * 2).sleep();
-    std::string s1;
-    for (int i = 0; i<output.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", output[i]);
-        s1 = s1 + str + " ";
-    }
-    if (test_flags)
-        ROS_INFO_STREAM("Write: " << s1);
-    std::vector<uint8_t> input;
-    while (input.empty()) {
-        port->read(input, (size_t)64);
-    }
-    std::string s2;
-    for (int i = 0; i<input.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", input[i]);
-        s2 = s2 + str + " ";
-    }
-    if (test_flags)
-        ROS_INFO_STREAM("Read: " << s2);
-    int temp[10] = { 0 };
-    for (int j = 0; j<1; j++)
-        temp[j] = input[7];
-    if (temp[0] == 1)
-        return true;
-    else
-        return false;
 }
 
-bool
-hand_serial::setSAVE_FLASH(serial::Serial *port)
+std::vector<uint8_t>
+hand_serial::writeFrame(uint16_t addr, const int *value, int count, int width)
 {
     std::vector<uint8_t> output;
-    //msave_flashsage from master to module
+    //message from master to module
     output.push_back(0xEB);
     output.push_back(0x90);
     //module id
     output.push_back(hand_id_);
-    //Data Length
-    output.push_back(0x04);
-    //Command get state
-    output.push_back(0x012);
-    output.push_back(0xED);
-    output.push_back(0x03);
-    output.push_back(0x01);
-
-    //Checksum calculation
-    unsigned int check_num = 0;
-    int len = output[3] + 5;
-    for (int i = 2; i < len - 1; i++)
-        check_num = check_num + output[i];
-    //Add checksum to the output buffer
-    output.push_back(check_num & 0xff);
-    //Send msave_flashsage to the module
-    port->write(output);
-    ros::Duration(0.5 * 2).sleep();
-    std::string s1;
-    for (int i = 0; i<output.size(); ++i)
+    //Data Length: command, address and width bytes per register
+    output.push_back(count * width + 3);
+    //Command write register
+    output.push_back(0x12);
+    output.push_back(addr & 0xff);
+    output.push_back((addr >> 8) & 0xff);
+    for (int i = 0; i < count; i++)
     {
-        char str[16];
-        sprintf(str, "%02X", output[i]);
-        s1 = s1 + str + " ";
-    }
-    if (test_flags)
-        ROS_INFO_STREAM("Write: " << s1);
-    std::vector<uint8_t> input;
-    while (input.empty()) {
-        port->read(input, (size_t)64);
+        unsigned int temp_int = (unsigned int)value[i];
+        output.push_back(temp_int & 0xff);
+        if (width == 2)
+            output.push_back((temp_int >> 8) & 0xff);
     }
-    std::string s2;
-    for (int i = 0; i<input.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", input[i]);
-        s2 = s2 + str + " ";
-    }
-    if (test_flags)
-        ROS_INFO_STREAM("Read: " << s2);
-    int temp[10] = { 0 };
-    for (int j = 0; j<1; j++)
-        temp[j] = input[7];
-    if (temp[0] == 1)
-        return true;
-    else
-        return false;
+    return output;
 }
 
-bool
-hand_serial::setRESET_PARA(serial::Serial *port)
+std::vector<uint8_t>
+hand_serial::readFrame(uint16_t addr, int bytes)
 {
     std::vector<uint8_t> output;
-    //mreset_parasage from master to module
+    //message from master to module
     output.push_back(0xEB);
     output.push_back(0x90);
     //module id
     output.push_back(hand_id_);
     //Data Length
     output.push_back(0x04);
-    //Command get state
-    output.push_back(0x012);
-    output.push_back(0xEE);
-    output.push_back(0x03);
-    output.push_back(0x01);
+    //Command read register, the last byte is the number of bytes wanted
+    output.push_back(0x11);
+    output.push_back(addr & 0xff);
+    output.push_back((addr >> 8) & 0xff);
+    output.push_back(bytes);
+    return output;
+}
 
-    //Checksum calculation
-    unsigned int check_num = 0;
-    int len = output[3] + 5;
-    for (int i = 2; i < len - 1; i++)
-        check_num = check_num + output[i];
-    //Add checksum to the output buffer
-    output.push_back(check_num & 0xff);
-    //Send mreset_parasage to the module
-    port->write(output);
-    ros::Duration(0.5 * 2).sleep();
-    std::string s1;
-    for (int i = 0; i<output.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", output[i]);
-        s1 = s1 + str + " ";
-    }
-    if (test_flags)
-        ROS_INFO_STREAM("Write: " << s1);
-    std::vector<uint8_t> input;
-    while (input.empty()) {
-        port->read(input, (size_t)64);
-    }
-    std::string s2;
-    for (int i = 0; i<input.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", input[i]);
-        s2 = s2 + str + " ";
-    }
-    if (test_flags)
-        ROS_INFO_STREAM("Read: " << s2);
-    int temp[10] = { 0 };
-    for (int j = 0; j<1; j++)
-        temp[j] = input[7];
-    if (temp[0] == 1)
-        return true;
-    else
-        return false;
-}
-
-bool
-hand_serial::setFORCE_CLB(serial::Serial *port)
+std::string
+hand_serial::hexString(const std::vector<uint8_t> &data)
 {
-    std::vector<uint8_t> output;
-    //mforce_clbsage from master to module
-    output.push_back(0xEB);
-    output.push_back(0x90);
-    //module id
-    output.push_back(hand_id_);
-    //Data Length
-    output.push_back(0x04);
-    //Command get state
-    output.push_back(0x012);
-    output.push_back(0xF1);
-    output.push_back(0x03);
-    output.push_back(0x01);
-
-    //Checksum calculation
-    unsigned int check_num = 0;
-    int len = output[3] + 5;
-    for (int i = 2; i < len - 1; i++)
-        check_num = check_num + output[i];
-    //Add checksum to the output buffer
-    output.push_back(check_num & 0xff);
-    //Send mforce_clbsage to the module
-    port->write(output);
-    ros::Duration(0.5 * 2).sleep();
-    std::string s1;
-    for (int i = 0; i<output.size(); ++i)
+    std::string s;
+    for (size_t i = 0; i < data.size(); ++i)
     {
         char str[16];
-        sprintf(str, "%02X", output[i]);
-        s1 = s1 + str + " ";
-    }
-    if (test_flags)
-        ROS_INFO_STREAM("Write: " << s1);
-    std::vector<uint8_t> input;
-    while (input.empty()) {
-        port->read(input, (size_t)64);
+        sprintf(str, "%02X", data[i]);
+        s = s + str + " ";
     }
-    std::string s2;
-    for (int i = 0; i<input.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", input[i]);
-        s2 = s2 + str + " ";
-    }
-    if (test_flags)
-        ROS_INFO_STREAM("Read: " << s2);
-    int temp[10] = { 0 };
-    for (int j = 0; j<1; j++)
-        temp[j] = input[7];
-    if (temp[0] == 1)
-        return true;
-    else
-        return false;
+    return s;
 }
 
-bool
-hand_serial::setGESTURE_NO(serial::Serial *port, int gesture_no)
+int
+hand_serial::start(serial::Serial *port)
 {
-    std::vector<uint8_t> output;
-    //message from master to module
-    output.push_back(0xEB);
-    output.push_back(0x90);
-    //module gesture_no
-    output.push_back(hand_id_);
-    //Data Length
-    output.push_back(0x04);
-    //Command get state
-    output.push_back(0x12);
-    output.push_back(0xF0);
-    output.push_back(0x03);
+    bus_grant grant(bus_scheduler_, BUS_COMMAND);
+    std::lock_guard<std::mutex> lock(bus_mutex_);
 
-    unsigned int temp_int2;
-    temp_int2 = (unsigned int)gesture_no;
+    std::vector<uint8_t> output = readFrame(reg::POS_ACT::addr, reg::POS_ACT::bytes);
+    appendChecksum(output);
 
-    output.push_back(temp_int2);
-    //Checksum calculation
-
-    unsigned int check_num = 0;
-    int len = output[3] + 5;
-
-    for (int i = 2; i < len - 1; i++)
-        check_num = check_num + output[i];
-    //Add checksum to the output buffer
-    output.push_back(check_num & 0xff);
-    //Send message to the module
-    port->write(output);
-    ros::Duration(0.015).sleep();
-    std::string s1;
-
-    for (int i = 0; i<output.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", output[i]);
-        s1 = s1 + str + " ";
-    }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Write: " << s1);
-    std::vector<uint8_t> input;
-    while (input.empty()) {
-        port->read(input, (size_t)64);
-    }
-    std::string s2;
-    for (int i = 0; i<input.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", input[i]);
-        s2 = s2 + str + " ";
-    }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Read: " << s2);
-    int temp[10] = { 0 };
-    for (int j = 0; j<1; j++)
-        temp[j] = input[7];
-    if (temp[0] == 1)
-        return true;
+    //Send message to the module and wait for response; only a valid answer from this id counts
+    std::vector<std::vector<uint8_t> > requests(1, output);
+    std::vector<std::vector<uint8_t> > responses;
+    //ROS_INFO("ok");
+    if (exchange(port, requests, responses, 0.015) != TR_OK)
+        return 0;
     else
-        return false;
+        return 1;
 }
 bool
-hand_serial::setCURRENT_LIMIT(serial::Serial *port,int current0,int current1,int current2,int current3,int current4,int current5)
+hand_serial::setID(serial::Serial *port,int id)
 {
-    std::vector<uint8_t> output;
-    //message from master to module
-    output.push_back(0xEB);
-    output.push_back(0x90);
-    //module id
-    output.push_back(hand_id_);
-    //Data Length
-    output.push_back(0x0F);
-    //Command get state
-    output.push_back(0x12);
-    output.push_back(0xFC);
-    output.push_back(0x03);
-
-    unsigned int temp_int1,temp_int2,temp_int3,temp_int4,temp_int5,temp_int6;
-    temp_int1 = (unsigned int)current0;
-    temp_int2 = (unsigned int)current1;
-    temp_int3 = (unsigned int)current2;
-    temp_int4 = (unsigned int)current3;
-    temp_int5 = (unsigned int)current4;
-    temp_int6 = (unsigned int)current5;
-
-    output.push_back(temp_int1 & 0xff);
-    output.push_back((temp_int1 >> 8) & 0xff);
-    output.push_back(temp_int2 & 0xff);
-    output.push_back((temp_int2 >> 8) & 0xff);
-    output.push_back(temp_int3 & 0xff);
-    output.push_back((temp_int3 >> 8) & 0xff);
-    output.push_back(temp_int4 & 0xff);
-    output.push_back((temp_int4 >> 8) & 0xff);
-    output.push_back(temp_int5 & 0xff);
-    output.push_back((temp_int5 >> 8) & 0xff);
-    output.push_back(temp_int6 & 0xff);
-    output.push_back((temp_int6 >> 8) & 0xff);
-
-    //Checksum calculation
-
-    unsigned int check_num = 0;
-    int len = output[3] + 5;
-
-    for (int i = 2; i < len - 1; i++)
-        check_num = check_num + output[i];
-
-    //Add checksum to the output buffer
-    output.push_back(check_num & 0xff);
-
-    //Send message to the module
-    port->write(output);
-
-    ros::Duration(0.015).sleep();
-
-    std::string s1;
-
-    for (int i = 0; i<output.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", output[i]);
-        s1 = s1 + str + " ";
-    }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Write: " << s1);
-
+    if (!checkRange<reg::ID>(&id, 1))
+        return false;
+    //The frame goes to the old id, answers() takes the ack from either; the driver only
+    //switches ids once the module has acknowledged
+    std::vector<uint8_t> output = writeFrame(reg::ID::addr, &id, 1, reg::ID::width);
     std::vector<uint8_t> input;
-    while (input.empty()) {
-        port->read(input, (size_t)64);
-    }
-    std::string s2;
-    for (int i = 0; i<input.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", input[i]);
-        s2 = s2 + str + " ";
-    }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Read: " << s2);
-    int temp[10] = { 0 };
-    for (int j = 0; j<1; j++)
-        temp[j] = input[7];
-    if (temp[0] == 1)
-        return true;
-    else
+    if (transaction(port, output, input, 0.015) != TR_OK || input[7] != 1)
         return false;
+    hand_id_ = id;
+    return true;
 }
 bool
-hand_serial::setDEFAULT_SPEED(serial::Serial *port,int speed0,int speed1,int speed2,int speed3,int speed4,int speed5)
+hand_serial::setREDU_RATIO(serial::Serial *port,int redu_ratio)
 {
-    std::vector<uint8_t> output;
-
-    //message from master to module
-    output.push_back(0xEB);
-    output.push_back(0x90);
-    //module id
-    output.push_back(hand_id_);
-    //Data Length
-    output.push_back(0x0F);
-    //Command get state
-    output.push_back(0x12);
-    output.push_back(0x08);
-    output.push_back(0x04);
-
-    unsigned int temp_int1,temp_int2,temp_int3,temp_int4,temp_int5,temp_int6;
-    temp_int1 = (unsigned int)speed0;
-    temp_int2 = (unsigned int)speed1;
-    temp_int3 = (unsigned int)speed2;
-    temp_int4 = (unsigned int)speed3;
-    temp_int5 = (unsigned int)speed4;
-    temp_int6 = (unsigned int)speed5;
-
-    output.push_back(temp_int1 & 0xff);
-    output.push_back((temp_int1 >> 8) & 0xff);
-    output.push_back(temp_int2 & 0xff);
-    output.push_back((temp_int2 >> 8) & 0xff);
-    output.push_back(temp_int3 & 0xff);
-    output.push_back((temp_int3 >> 8) & 0xff);
-    output.push_back(temp_int4 & 0xff);
-    output.push_back((temp_int4 >> 8) & 0xff);
-    output.push_back(temp_int5 & 0xff);
-    output.push_back((temp_int5 >> 8) & 0xff);
-    output.push_back(temp_int6 & 0xff);
-    output.push_back((temp_int6 >> 8) & 0xff);
-
-    //Checksum calculation
-
-    unsigned int check_num = 0;
-    int len = output[3] + 5;
-
-    for (int i = 2; i < len - 1; i++)
-        check_num = check_num + output[i];
-
-    //Add checksum to the output buffer
-    output.push_back(check_num & 0xff);
-
-    //Send message to the module
-    port->write(output);
-
-    ros::Duration(0.015).sleep();
-
-    std::string s1;
-
-    for (int i = 0; i<output.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", output[i]);
-        s1 = s1 + str + " ";
-    }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Write: " << s1);
-
-    std::vector<uint8_t> input;
-
-    while (input.empty()) {
-        port->read(input, (size_t)64);
-    }
+    if (!checkRange<reg::REDU_RATIO>(&redu_ratio, 1))
+        return false;
 
-    std::string s2;
-    for (int i = 0; i<input.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", input[i]);
-        s2 = s2 + str + " ";
-    }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Read: " << s2);
-    int temp[10] = { 0 };
-    for (int j = 0; j<1; j++)
-        temp[j] = input[7];
-    if (temp[0] == 1)
-        return true;
+    if (redu_ratio == 0)
+        baudrate_ = 115200;
+    else if (redu_ratio == 1)
+        baudrate_ = 57600;
     else
-        return false;
+        baudrate_ = 19200;
+    return writeRegister<reg::REDU_RATIO>(port, &redu_ratio);
 }
+
 bool
-hand_serial::setDEFAULT_FORCE(serial::Serial *port, int force0, int force1, int force2, int force3, int force4, int force5)
+hand_serial::setCLEAR_ERROR(serial::Serial *port, const maintenance_progress &progress)
 {
-    std::vector<uint8_t> output;
-    //message from master to module
-    output.push_back(0xEB);
-    output.push_back(0x90);
-    //module id
-    output.push_back(hand_id_);
-    //Data Length
-    output.push_back(0x0F);
-    //Command get state
-    output.push_back(0x12);
-    output.push_back(0x14);
-    output.push_back(0x04);
-
-    unsigned int temp_int1, temp_int2, temp_int3, temp_int4, temp_int5, temp_int6;
-
-    temp_int1 = (unsigned int)force0;
-    temp_int2 = (unsigned int)force1;
-    temp_int3 = (unsigned int)force2;
-    temp_int4 = (unsigned int)force3;
-    temp_int5 = (unsigned int)force4;
-    temp_int6 = (unsigned int)force5;
-
-    output.push_back(temp_int1 & 0xff);
-    output.push_back((temp_int1 >> 8) & 0xff);
-    output.push_back(temp_int2 & 0xff);
-    output.push_back((temp_int2 >> 8) & 0xff);
-    output.push_back(temp_int3 & 0xff);
-    output.push_back((temp_int3 >> 8) & 0xff);
-    output.push_back(temp_int4 & 0xff);
-    output.push_back((temp_int4 >> 8) & 0xff);
-    output.push_back(temp_int5 & 0xff);
-    output.push_back((temp_int5 >> 8) & 0xff);
-    output.push_back(temp_int6 & 0xff);
-    output.push_back((temp_int6 >> 8) & 0xff);
-
-    //Checksum calculation
-    unsigned int check_num = 0;
-    int len = output[3] + 5;
-
-    for (int i = 2; i < len - 1; i++)
-        check_num = check_num + output[i];
-
-    //Add checksum to the output buffer
-    output.push_back(check_num & 0xff);
-
-    //Send message to the module
-    port->write(output);
-
-    ros::Duration(0.015).sleep();
-
-    std::string s1;
-
-    for (int i = 0; i<output.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", output[i]);
-        s1 = s1 + str + " ";
-    }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Write: " << s1);
-
-    std::vector<uint8_t> input;
-
-    while (input.empty()) {
-        port->read(input, (size_t)64);
-    }
-
-    std::string s2;
-    for (int i = 0; i<input.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", input[i]);
-        s2 = s2 + str + " ";
-    }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Read: " << s2);
-    int temp[10] = { 0 };
-    for (int j = 0; j<1; j++)
-        temp[j] = input[7];
-    if (temp[0] == 1)
-        return true;
-    else
+    //Only the write is waited for here, completion is polled below
+    const int trigger = 1;
+    if (!writeRegister<reg::CLEAR_ERROR>(port, &trigger))
         return false;
+    return waitMaintenance(port, MAINT_CLEAR_ERROR, progress);
 }
-bool
-hand_serial::setUSER_DEF_ANGLE(serial::Serial *port,int angle0,int angle1,int angle2,int angle3,int angle4,int angle5,int k)
 
+bool
+hand_serial::setSAVE_FLASH(serial::Serial *port, const maintenance_progress &progress)
 {
-    std::vector<uint8_t> output;
-    //message from master to module
-    output.push_back(0xEB);
-    output.push_back(0x90);
-    //module id
-    output.push_back(hand_id_);
-    //Data Length
-    output.push_back(0x0F);
-    //Command get state
-    output.push_back(0x12);
-    int temp1;
-    temp1 = 1066 + (k - 14) * 12;
-    unsigned int temp_int;
-    temp_int = (unsigned int)temp1;
-    output.push_back(temp_int & 0xff);
-    output.push_back((temp_int >> 8) & 0xff);
-
-    unsigned int temp_int1, temp_int2, temp_int3, temp_int4, temp_int5, temp_int6;
-
-    temp_int1 = (unsigned int)angle0;
-    temp_int2 = (unsigned int)angle1;
-    temp_int3 = (unsigned int)angle2;
-    temp_int4 = (unsigned int)angle3;
-    temp_int5 = (unsigned int)angle4;
-    temp_int6 = (unsigned int)angle5;
-
-    output.push_back(temp_int1 & 0xff);
-    output.push_back((temp_int1 >> 8) & 0xff);
-    output.push_back(temp_int2 & 0xff);
-    output.push_back((temp_int2 >> 8) & 0xff);
-    output.push_back(temp_int3 & 0xff);
-    output.push_back((temp_int3 >> 8) & 0xff);
-    output.push_back(temp_int4 & 0xff);
-    output.push_back((temp_int4 >> 8) & 0xff);
-    output.push_back(temp_int5 & 0xff);
-    output.push_back((temp_int5 >> 8) & 0xff);
-    output.push_back(temp_int6 & 0xff);
-    output.push_back((temp_int6 >> 8) & 0xff);
-
-    //Checksum calculation
-    unsigned int check_num = 0;
-    int len = output[3] + 5;
-
-    for (int i = 2; i < len - 1; i++)
-        check_num = check_num + output[i];
-    //Add checksum to the output buffer
-    output.push_back(check_num & 0xff);
-
-    //Send message to the module
-    port->write(output);
-
-    ros::Duration(0.015).sleep();
-
-    std::string s1;
-
-    for (int i = 0; i<output.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", output[i]);
-        s1 = s1 + str + " ";
-    }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Write: " << s1);
-
-    std::vector<uint8_t> input;
-
-    while (input.empty()) {
-        port->read(input, (size_t)64);
-    }
-
-    std::string s2;
-    for (int i = 0; i<input.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", input[i]);
-        s2 = s2 + str + " ";
-    }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Read: " << s2);
-    int temp[10] = { 0 };
-    for (int j = 0; j<1; j++)
-        temp[j] = input[7];
-    if (temp[0] == 1)
-        return true;
-    else
+    //Only the write is waited for here, completion is polled below
+    const int trigger = 1;
+    if (!writeRegister<reg::SAVE>(port, &trigger))
         return false;
+    return waitMaintenance(port, MAINT_SAVE_FLASH, progress);
 }
 
 bool
-hand_serial::setPOS(serial::Serial *port, int pos0, int pos1, int pos2, int pos3, int pos4, int pos5)
+hand_serial::setRESET_PARA(serial::Serial *port, const maintenance_progress &progress)
 {
-    std::vector<uint8_t> output;
-    //message from master to module
-    output.push_back(0xEB);
-    output.push_back(0x90);
-    //module id
-    output.push_back(hand_id_);
-    //Data Length
-    output.push_back(0x0F);
-    //Command get state
-    output.push_back(0x12);
-    output.push_back(0xC2);
-    output.push_back(0x05);
-
-    unsigned int temp_int1, temp_int2, temp_int3, temp_int4, temp_int5, temp_int6;
-    temp_int1 = (unsigned int)pos0;
-    temp_int2 = (unsigned int)pos1;
-    temp_int3 = (unsigned int)pos2;
-    temp_int4 = (unsigned int)pos3;
-    temp_int5 = (unsigned int)pos4;
-    temp_int6 = (unsigned int)pos5;
-
-    output.push_back(temp_int1 & 0xff);
-    output.push_back((temp_int1 >> 8) & 0xff);
-    output.push_back(temp_int2 & 0xff);
-    output.push_back((temp_int2 >> 8) & 0xff);
-    output.push_back(temp_int3 & 0xff);
-    output.push_back((temp_int3 >> 8) & 0xff);
-    output.push_back(temp_int4 & 0xff);
-    output.push_back((temp_int4 >> 8) & 0xff);
-    output.push_back(temp_int5 & 0xff);
-    output.push_back((temp_int5 >> 8) & 0xff);
-    output.push_back(temp_int6 & 0xff);
-    output.push_back((temp_int6 >> 8) & 0xff);
-    //Checksum calculation
-    unsigned int check_num = 0;
-    int len = output[3] + 5;
-
-    for (int i = 2; i < len - 1; i++)
-        check_num = check_num + output[i];
-    //Add checksum to the output buffer
-    output.push_back(check_num & 0xff);
-    //Send message to the module
-    port->write(output);
-    ros::Duration(0.015).sleep();
-    std::string s1;
-
-    for (int i = 0; i<output.size(); ++i)
+    //Factory defaults replace the setpoints
     {
-        char str[16];
-        sprintf(str, "%02X", output[i]);
-        s1 = s1 + str + " ";
-    }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Write: " << s1);
-    std::vector<uint8_t> input;
-
-    while (input.empty()) {
-        port->read(input, (size_t)64);
+        std::lock_guard<std::mutex> lock(setpoint_mutex_);
+        for (int f = 0; f < SP_FIELD_COUNT; f++)
+            invalidateShadow(f);
     }
-
-    std::string s2;
-    for (int i = 0; i<input.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", input[i]);
-        s2 = s2 + str + " ";
-    }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Read: " << s2);
-    int temp[10] = { 0 };
-    for (int j = 0; j<1; j++)
-        temp[j] = input[7];
-    if (temp[0] == 1)
-        return true;
-    else
+    //Only the write is waited for here, completion is polled below
+    const int trigger = 1;
+    if (!writeRegister<reg::RESET_PARA>(port, &trigger))
         return false;
+    return waitMaintenance(port, MAINT_RESET_PARA, progress);
 }
+
 bool
-hand_serial::setANGLE(serial::Serial *port, int angle0, int angle1, int angle2, int angle3, int angle4, int angle5)
+hand_serial::setFORCE_CLB(serial::Serial *port, const maintenance_progress &progress)
 {
-    std::vector<uint8_t> output;
-    //message from master to module
-    output.push_back(0xEB);
-    output.push_back(0x90);
-    //module id
-    output.push_back(hand_id_);
-    //Data Length
-    output.push_back(0x0F);
-    //Command get state
-    output.push_back(0x12);
-    output.push_back(0xCE);
-    output.push_back(0x05);
-
-    int temp_int1,temp_int2,temp_int3,temp_int4,temp_int5,temp_int6;
-    temp_int1 = angle0;
-    temp_int2 = angle1;
-    temp_int3 = angle2;
-    temp_int4 = angle3;
-    temp_int5 = angle4;
-    temp_int6 = angle5;
-
-    output.push_back(temp_int1 & 0xff);
-    output.push_back((temp_int1 >> 8) & 0xff);
-    output.push_back(temp_int2 & 0xff);
-    output.push_back((temp_int2 >> 8) & 0xff);
-    output.push_back(temp_int3 & 0xff);
-    output.push_back((temp_int3 >> 8) & 0xff);
-    output.push_back(temp_int4 & 0xff);
-    output.push_back((temp_int4 >> 8) & 0xff);
-    output.push_back(temp_int5 & 0xff);
-    output.push_back((temp_int5 >> 8) & 0xff);
-    output.push_back(temp_int6 & 0xff);
-    output.push_back((temp_int6 >> 8) & 0xff);
-    //Checksum calculation
-
-    unsigned int check_num = 0;
-    int len = output[3] + 5;
-
-    for (int i = 2; i < len - 1; i++)
-        check_num = check_num + output[i];
-    //Add checksum to the output buffer
-    output.push_back(check_num & 0xff);
-
-    //Send message to the module
-    port->write(output);
-
-    ros::Duration(0.015).sleep();
-
-    std::string s1;
-
-    for (int i = 0; i<output.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", output[i]);
-        s1 = s1 + str + " ";
-    }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Write: " << s1);
-
-    std::vector<uint8_t> input;
-
-    while (input.empty())
-    {
-        port->read(input, (size_t)64);
-    }
-
-    std::string s2;
-    for (int i = 0; i<input.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", input[i]);
-        s2 = s2 + str + " ";
-    }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Read: " << s2);
-    int temp[10] = { 0 };
-    for (int j = 0; j<1; j++)
-        temp[j] = input[7];
-    if (temp[0] == 1)
-        return true;
-    else
+    //Only the write is waited for here, completion is polled below
+    const int trigger = 1;
+    if (!writeRegister<reg::FORCE_CLB>(port, &trigger))
         return false;
+    return waitMaintenance(port, MAINT_FORCE_CLB, progress);
 }
 
 bool
-hand_serial::setFORCE(serial::Serial *port,int force0,int force1,int force2,int force3,int force4,int force5)
+hand_serial::setGESTURE_NO(serial::Serial *port, int gesture_no)
 {
-    std::vector<uint8_t> output;
-
-    //message from master to module
-    output.push_back(0xEB);
-    output.push_back(0x90);
-    //module id
-    output.push_back(hand_id_);
-    //Data Length
-    output.push_back(0x0F);
-    //Command get state
-    output.push_back(0x12);
-    output.push_back(0xDA);
-    output.push_back(0x05);
-
-    unsigned int temp_int1, temp_int2, temp_int3, temp_int4, temp_int5, temp_int6;
-    temp_int1 = (unsigned int)force0;
-    temp_int2 = (unsigned int)force1;
-    temp_int3 = (unsigned int)force2;
-    temp_int4 = (unsigned int)force3;
-    temp_int5 = (unsigned int)force4;
-    temp_int6 = (unsigned int)force5;
-
-    output.push_back(temp_int1 & 0xff);
-    output.push_back((temp_int1 >> 8) & 0xff);
-    output.push_back(temp_int2 & 0xff);
-    output.push_back((temp_int2 >> 8) & 0xff);
-    output.push_back(temp_int3 & 0xff);
-    output.push_back((temp_int3 >> 8) & 0xff);
-    output.push_back(temp_int4 & 0xff);
-    output.push_back((temp_int4 >> 8) & 0xff);
-    output.push_back(temp_int5 & 0xff);
-    output.push_back((temp_int5 >> 8) & 0xff);
-    output.push_back(temp_int6 & 0xff);
-    output.push_back((temp_int6 >> 8) & 0xff);
-
-    //Checksum calculation
-    unsigned int check_num = 0;
-    int len = output[3] + 5;
-
-    for (int i = 2; i < len - 1; i++)
-        check_num = check_num + output[i];
-
-    //Add checksum to the output buffer
-    output.push_back(check_num & 0xff);
-
-    //Send message to the module
-    port->write(output);
-
-    ros::Duration(0.015).sleep();
-
-    std::string s1;
-    for (int i = 0; i<output.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", output[i]);
-        s1 = s1 + str + " ";
-    }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Write: " << s1);
-    std::vector<uint8_t> input;
-
-    while (input.empty()) {
-        port->read(input, (size_t)64);
-    }
-
-    std::string s2;
-    for (int i = 0; i<input.size(); ++i)
+    if (!checkRange<reg::GESTURE_NO>(&gesture_no, 1))
+        return false;
+    //A gesture loads its own angle, force and speed targets
     {
-        char str[16];
-        sprintf(str, "%02X", input[i]);
-        s2 = s2 + str + " ";
+        std::lock_guard<std::mutex> lock(setpoint_mutex_);
+        for (int f = 0; f < SP_FIELD_COUNT; f++)
+            invalidateShadow(f);
     }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Read: " << s2);
-    int temp[10] = { 0 };
-    for (int j = 0; j<1; j++)
-        temp[j] = input[7];
-    if (temp[0] == 1)
-        return true;
-    else
-        return false;
+    return writeRegister<reg::GESTURE_NO>(port, &gesture_no);
 }
-
 bool
-hand_serial::setSPEED(serial::Serial *port, int speed0, int speed1, int speed2, int speed3, int speed4, int speed5)
+hand_serial::setCURRENT_LIMIT(serial::Serial *port,int current0,int current1,int current2,int current3,int current4,int current5)
 {
-    std::vector<uint8_t> output;
-    //message from master to module
-    output.push_back(0xEB);
-    output.push_back(0x90);
-    //module id
-    output.push_back(hand_id_);
-    //Data Length
-    output.push_back(0x0F);
-    //Command get state
-    output.push_back(0x12);
-    output.push_back(0xF2);
-    output.push_back(0x05);
-
-    unsigned int temp_int1, temp_int2, temp_int3, temp_int4, temp_int5, temp_int6;
-    temp_int1 = (unsigned int)speed0;
-    temp_int2 = (unsigned int)speed1;
-    temp_int3 = (unsigned int)speed2;
-    temp_int4 = (unsigned int)speed3;
-    temp_int5 = (unsigned int)speed4;
-    temp_int6 = (unsigned int)speed5;
-
-    output.push_back(temp_int1 & 0xff);
-    output.push_back((temp_int1 >> 8) & 0xff);
-    output.push_back(temp_int2 & 0xff);
-    output.push_back((temp_int2 >> 8) & 0xff);
-    output.push_back(temp_int3 & 0xff);
-    output.push_back((temp_int3 >> 8) & 0xff);
-    output.push_back(temp_int4 & 0xff);
-    output.push_back((temp_int4 >> 8) & 0xff);
-    output.push_back(temp_int5 & 0xff);
-    output.push_back((temp_int5 >> 8) & 0xff);
-    output.push_back(temp_int6 & 0xff);
-    output.push_back((temp_int6 >> 8) & 0xff);
-
-    //Checksum calculation
-
-    unsigned int check_num = 0;
-    int len = output[3] + 5;
-
-    for (int i = 2; i < len - 1; i++)
-        check_num = check_num + output[i];
-
-    //Add checksum to the output buffer
-    output.push_back(check_num & 0xff);
-
-    //Send message to the module
-    port->write(output);
-
-    ros::Duration(0.015).sleep();
-
-    std::string s1;
-
-    for (int i = 0; i<output.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", output[i]);
-        s1 = s1 + str + " ";
-    }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Write: " << s1);
-
-    std::vector<uint8_t> input;
-
-    while (input.empty()) {
-        port->read(input, (size_t)64);
-    }
-
-    std::string s2;
-    for (int i = 0; i<input.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", input[i]);
-        s2 = s2 + str + " ";
-    }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Read: " << s2);
-    int temp[10] = { 0 };
-    for (int j = 0; j<1; j++)
-        temp[j] = input[7];
-    if (temp[0] == 1)
-        return true;
-    else
+    int currents[6] = { current0, current1, current2, current3, current4, current5 };
+    return writeRegister<reg::CURRENT_LIMIT>(port, currents);
+}
+bool
+hand_serial::setDEFAULT_SPEED(serial::Serial *port,int speed0,int speed1,int speed2,int speed3,int speed4,int speed5)
+{
+    int speeds[6] = { speed0, speed1, speed2, speed3, speed4, speed5 };
+    return writeRegister<reg::DEFAULT_SPEED>(port, speeds);
+}
+bool
+hand_serial::setDEFAULT_FORCE(serial::Serial *port, int force0, int force1, int force2, int force3, int force4, int force5)
+{
+    int forces[6] = { force0, force1, force2, force3, force4, force5 };
+    return writeRegister<reg::DEFAULT_FORCE>(port, forces);
+}
+bool
+hand_serial::setUSER_DEF_ANGLE(serial::Serial *port,int angle0,int angle1,int angle2,int angle3,int angle4,int angle5,int k)
+{
+    if (k < 14 || k > 45)
         return false;
+    int angles[6] = { angle0, angle1, angle2, angle3, angle4, angle5 };
+    //Gestures 14-45 hold six angles each
+    return writeRegister<reg::USER_DEF_ANGLE>(port, angles, (k - 14) * 6, 6);
 }
 
-void
-hand_serial::getPOS_ACT(serial::Serial *port)
+bool
+hand_serial::setPOS(serial::Serial *port, int pos0, int pos1, int pos2, int pos3, int pos4, int pos5)
 {
-    std::vector<uint8_t> output;
-    //message from master to module
-    output.push_back(0xEB);
-    output.push_back(0x90);
-    //module id
-    output.push_back(hand_id_);
-    //Data Length
-    output.push_back(0x04);
-    //Command get state
-    output.push_back(0x11);
-    output.push_back(0xFE);
-    output.push_back(0x05);
-    output.push_back(0x0C);
-    //Checksum calculation
-    unsigned int check_num = 0;
-    int len = output[3] + 5;
-    for (int i = 2; i < len - 1; i++)
-        check_num = check_num + output[i];
-    //Add checksum to the output buffer
-    output.push_back(check_num & 0xff);
-    //Send message to the module
-    port->write(output);
-
-    ros::Duration(0.015).sleep();
-
-    std::string s1;
-    for (int i = 0; i<output.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", output[i]);
-        s1 = s1 + str + " ";
-    }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Write: " << s1);
-
-    //Read response
-    std::vector<uint8_t> input;
-    while (input.empty())
+    int positions[6] = { pos0, pos1, pos2, pos3, pos4, pos5 };
+    if (!checkRange<reg::POS_SET>(positions, 6))
+        return false;
+    //POS_SET moves the angle targets as well
     {
-        port->read(input, (size_t)64);
+        std::lock_guard<std::mutex> lock(setpoint_mutex_);
+        invalidateShadow(SP_ANGLE);
     }
+    return writeRegister<reg::POS_SET>(port, positions);
+}
+bool
+hand_serial::setANGLE(serial::Serial *port, int angle0, int angle1, int angle2, int angle3, int angle4, int angle5)
+{
+    int angles[6] = { angle0, angle1, angle2, angle3, angle4, angle5 };
+    if (!checkRange<reg::ANGLE_SET>(angles, 6))
+        return false;
 
-    std::string s2;
-    for (int i = 0; i<input.size(); ++i)
+    //Commanded angles for the dataset export (-1 keeps the previous target)
     {
-        char str[16];
-        sprintf(str, "%02X", input[i]);
-        s2 = s2 + str + " ";
+        std::lock_guard<std::mutex> lock(setpoint_mutex_);
+        for (int i = 0; i < 6; i++)
+            if (angles[i] >= 0)
+                cmdangle_[i] = float(angles[i]);
     }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Read: " << s2);
 
-    int temp[10] = { 0 };
-    for (int j = 0; j<6; j++)
-        temp[j] = ((input[8 + j * 2] << 8) & 0xff00) + input[7 + j * 2];
-    //ROS_INFO("Gripper: No error detected");
-    ROS_INFO_STREAM("hand: current pos: "
-                    << temp[0]
-            << " "
-            << temp[1]
-            << " "
-            << temp[2]
-            << " "
-            << temp[3]
-            << " "
-            << temp[4]
-            << " "
-            << temp[5]
-               );
-
-    curpos_[0] = float(temp[0]);
-    curpos_[1] = float(temp[1]);
-    curpos_[2] = float(temp[2]);
-    curpos_[3] = float(temp[3]);
-    curpos_[4] = float(temp[4]);
-    curpos_[5] = float(temp[5]);
+    //Without an ack the hand may or may not hold the new values
+    bool acked = writeRegister<reg::ANGLE_SET>(port, angles);
+    updateShadow(SP_ANGLE, angles, acked);
+    return acked;
 }
 
-void
-hand_serial::getANGLE_ACT(serial::Serial *port)
+bool
+hand_serial::setFORCE(serial::Serial *port,int force0,int force1,int force2,int force3,int force4,int force5)
 {
-    std::vector<uint8_t> output;
-    //message from master to module
-    output.push_back(0xEB);
-    output.push_back(0x90);
-    //module id
-    output.push_back(hand_id_);
-    //Data Length
-    output.push_back(0x04);
-    //Command get state
-    output.push_back(0x11);
-    output.push_back(0x0A);
-    output.push_back(0x06);
-    output.push_back(0x0C);
-    //Checksum calculation
-    unsigned int check_num = 0;
-    int len = output[3] + 5;
-    for (int i = 2; i < len - 1; i++)
-        check_num = check_num + output[i];
-    //Add checksum to the output buffer
-    output.push_back(check_num & 0xff);
-    //Send message to the module
-    port->write(output);
+    int forces[6] = { force0, force1, force2, force3, force4, force5 };
+    if (!checkRange<reg::FORCE_SET>(forces, 6))
+        return false;
+
+    //Without an ack the hand may or may not hold the new values
+    bool acked = writeRegister<reg::FORCE_SET>(port, forces);
+    updateShadow(SP_FORCE, forces, acked);
+    return acked;
+}
 
-    ros::Duration(0.015).sleep();
+bool
+hand_serial::setSPEED(serial::Serial *port, int speed0, int speed1, int speed2, int speed3, int speed4, int speed5)
+{
+    int speeds[6] = { speed0, speed1, speed2, speed3, speed4, speed5 };
+    if (!checkRange<reg::SPEED_SET>(speeds, 6))
+        return false;
+    scaleSpeeds(speeds);
+
+    //Without an ack the hand may or may not hold the new values
+    bool acked = writeRegister<reg::SPEED_SET>(port, speeds);
+    updateShadow(SP_SPEED, speeds, acked);
+    return acked;
+}
+
+bool
+hand_serial::setSETPOINTS(serial::Serial *port, const setpoint_targets &requested)
+{
+    std::lock_guard<std::mutex> lock(setpoint_mutex_);
+
+    //Speeds go out as the thermal throttle allows, unchanged ones are caught by the shadow below
+    setpoint_targets targets = requested;
+    scaleSpeeds(targets.value[SP_SPEED]);
+
+    //Last check before the frames are built, whichever path the targets came from
+    for (int f = 0; f < SP_FIELD_COUNT; f++)
+        for (int i = 0; i < 6; i++)
+            if (!checkSetpoint(f, targets.value[f][i]))
+                return false;
+
+    //A target is dirty when it is set and differs from what the hand last acknowledged
+    bool dirty[SP_FIELD_COUNT][6];
+    bool any_dirty = false;
+    for (int f = 0; f < SP_FIELD_COUNT; f++)
+        for (int i = 0; i < 6; i++)
+        {
+            int v = targets.value[f][i];
+            dirty[f][i] = v >= 0 && v != setpoint_shadow_[f][i];
+            any_dirty = any_dirty || dirty[f][i];
+        }
+
+    //Commanded angles for the dataset export (-1 keeps the previous target)
+    for (int i = 0; i < 6; i++)
+        if (targets.value[SP_ANGLE][i] >= 0)
+            cmdangle_[i] = float(targets.value[SP_ANGLE][i]);
 
-    std::string s1;
-    for (int i = 0; i<output.size(); ++i)
+    if (!any_dirty)
     {
-        char str[16];
-        sprintf(str, "%02X", output[i]);
-        s1 = s1 + str + " ";
+        setpoints_suppressed_++;
+        return true;
     }
-    //if (test_flags == 1)
-    //ROS_INFO_STREAM("Write: " << s1);
 
+    //ANGLE_SET and FORCE_SET are adjacent and form one block.
+    //SPEED_SET sits behind 0x05E6-0x05F1, which must not be written, so it always needs its own frame.
+    static_assert(writableSpan(reg::ANGLE_SET::addr, reg::FORCE_SET::end), "ANGLE_SET and FORCE_SET are not one block");
+    static_assert(!writableSpan(reg::ANGLE_SET::addr, reg::SPEED_SET::end), "SPEED_SET may join the block");
+    //Speed goes first so the motion already runs with the new profile
+    std::vector<std::vector<uint8_t> > frames;
+    //First register and count of each frame within its block, for the shadow update
+    std::vector<std::pair<int, int> > spans;
+    appendDirtyFrames(frames, spans, reg::SPEED_SET::addr, targets.value[SP_SPEED], dirty[SP_SPEED], 6);
+    size_t speed_frames = frames.size();
 
-    //Read response
-    std::vector<uint8_t> input;
-    while (input.empty())
+    int value[12];
+    bool block_dirty[12];
+    for (int i = 0; i < 6; i++)
     {
-        port->read(input, (size_t)64);
+        value[i] = targets.value[SP_ANGLE][i];
+        value[i + 6] = targets.value[SP_FORCE][i];
+        block_dirty[i] = dirty[SP_ANGLE][i];
+        block_dirty[i + 6] = dirty[SP_FORCE][i];
     }
+    appendDirtyFrames(frames, spans, reg::ANGLE_SET::addr, value, block_dirty, 12);
 
+    std::vector<bool> acked;
+    bool ok = transactionBatch(port, frames, 0.015, acked);
 
-    std::string s2;
-    for (int i = 0; i<input.size(); ++i)
+    for (size_t k = 0; k < frames.size(); ++k)
     {
-        char str[16];
-        sprintf(str, "%02X", input[i]);
-        s2 = s2 + str + " ";
-    }
-    //if (test_flags == 1)
-    //ROS_INFO_STREAM("Read: " << s2);
-
-
-    int temp[10] = { 0 };
-    for (int j = 0; j<6; j++)
-        temp[j] = ((input[8 + j * 2] << 8) & 0xff00) + input[7 + j * 2];
-    //ROS_INFO("Gripper: No error detected");
-    /*ROS_INFO_STREAM("hand: current angle: "
-                        << temp[0]
-                        << " "
-                        << temp[1]
-                        << " "
-                        << temp[2]
-                        << " "
-                        << temp[3]
-                        << " "
-                        << temp[4]
-                        << " "
-                        << temp[5]
-                );*/
-
-    curangle_[0] = float(temp[0]);
-    curangle_[1] = float(temp[1]);
-    curangle_[2] = float(temp[2]);
-    curangle_[3] = float(temp[3]);
-    curangle_[4] = float(temp[4]);
-    curangle_[5] = float(temp[5]);
+        setpoint_bytes_ += frames[k].size();
+        if (!acked[k])
+            continue;
+        for (int r = spans[k].first; r < spans[k].first + spans[k].second; r++)
+        {
+            //Filler registers inside a span were sent as 0xFFFF and are unchanged
+            if (k < speed_frames)
+            {
+                if (dirty[SP_SPEED][r])
+                    setpoint_shadow_[SP_SPEED][r] = targets.value[SP_SPEED][r];
+            }
+            else if (block_dirty[r])
+                setpoint_shadow_[r < 6 ? SP_ANGLE : SP_FORCE][r % 6] = value[r];
+        }
+    }
+    return ok;
 }
 
-
 void
-hand_serial::getFORCE_ACT(serial::Serial *port)
+hand_serial::appendDirtyFrames(std::vector<std::vector<uint8_t> > &frames, std::vector<std::pair<int, int> > &spans,
+                               uint16_t addr, const int *value, const bool *dirty, int count, const int *fill)
 {
-    std::vector<uint8_t> output;
-    //message from master to module
-    output.push_back(0xEB);
-    output.push_back(0x90);
-    //module id
-    output.push_back(hand_id_);
-    //Data Length
-    output.push_back(0x04);
-    //Command get state
-    output.push_back(0x11);
-    output.push_back(0x2E);
-    output.push_back(0x06);
-    output.push_back(0x0C);
-    //Checksum calculation
-    unsigned int check_num = 0;
-    int len = output[3] + 5;
-    for (int i = 2; i < len - 1; i++)
-        check_num = check_num + output[i];
-    //Add checksum to the output buffer
-    output.push_back(check_num & 0xff);
-    //Send message to the module
-    port->write(output);
+    //A new frame costs 8 request and 9 ack bytes, filling a gap costs 2 bytes per register.
+    //Gaps of up to 8 registers are cheaper to fill than to split
+    const int MAX_GAP = 8;
 
-    ros::Duration(0.015).sleep();
-
-    std::string s1;
-    for (int i = 0; i<output.size(); ++i)
+    int i = 0;
+    while (i < count)
     {
-        char str[16];
-        sprintf(str, "%02X", output[i]);
-        s1 = s1 + str + " ";
+        if (!dirty[i])
+        {
+            i++;
+            continue;
+        }
+        int first = i;
+        int last = i;
+        for (int j = i + 1; j < count && j - last <= MAX_GAP + 1; j++)
+            if (dirty[j])
+                last = j;
+
+        //Clean registers inside the span get their fill value, or 0xFFFF (keep)
+        std::vector<int> data;
+        for (int r = first; r <= last; r++)
+            data.push_back(dirty[r] ? value[r] : (fill != NULL ? fill[r] : -1));
+        frames.push_back(writeFrame(addr + 2 * first, &data[0], last - first + 1));
+        spans.push_back(std::make_pair(first, last - first + 1));
+        i = last + 1;
     }
-    //if (test_flags == 1)
-    //ROS_INFO_STREAM("Write: " << s1);
-
+}
 
-    //Read response
+transaction_result
+hand_serial::readBytes(serial::Serial *port, uint16_t addr, int count, uint8_t *value)
+{
+    std::vector<uint8_t> output = readFrame(addr, count);
+    //Send message to the module and wait for the response
     std::vector<uint8_t> input;
-    while (input.empty())
-    {
-        port->read(input, (size_t)64);
-    }
-    std::string s2;
-    for (int i = 0; i<input.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", input[i]);
-        s2 = s2 + str + " ";
-    }
-    //if (test_flags == 1)
-    //ROS_INFO_STREAM("Read: " << s2);
-
-    int temp[10] = { 0 };
-    for (int j = 0; j<6; j++)
-    {
-        temp[j] = ((input[8 + j * 2] << 8) & 0xff00) + input[7 + j * 2];
-        if(temp[j]>32768)
-            temp[j] = temp[j] - 65536;
-    }
-
-    //ROS_INFO("Gripper: No error detected");
-    /*ROS_INFO_STREAM("hand: current force: "
-                        << temp[0]
-                        << " "
-                        << temp[1]
-                        << " "
-                        << temp[2]
-                        << " "
-                        << temp[3]
-                        << " "
-                        << temp[4]
-                        << " "
-                        << temp[5]
-                );*/
-
-    curforce_[0] = float(temp[0]);
-    curforce_[1] = float(temp[1]);
-    curforce_[2] = float(temp[2]);
-    curforce_[3] = float(temp[3]);
-    curforce_[4] = float(temp[4]);
-    curforce_[5] = float(temp[5]);
+    transaction_result result = transaction(port, output, input, 0.015);
+    if (result != TR_OK)
+        return result;
+    if (input.size() < (size_t)(8 + count))
+        return TR_SHORT_FRAME;
+    for (int j = 0; j < count; j++)
+        value[j] = input[7 + j];
+    return TR_OK;
 }
 
-void
-hand_serial::getCURRENT(serial::Serial *port)
+bool
+hand_serial::waitMaintenance(serial::Serial *port, int operation, const maintenance_progress &progress)
 {
-    std::vector<uint8_t> output;
-    //message from master to module
-    output.push_back(0xEB);
-    output.push_back(0x90);
-    //module id
-    output.push_back(hand_id_);
-    //Data Length
-    output.push_back(0x04);
-    //Command get state
-    output.push_back(0x11);
-    output.push_back(0x3A);
-    output.push_back(0x06);
-    output.push_back(0x0C);
-    //Checksum calculation
-    unsigned int check_num = 0;
-    int len = output[3] + 5;
-    for (int i = 2; i < len - 1; i++)
-        check_num = check_num + output[i];
-    //Add checksum to the output buffer
-    output.push_back(check_num & 0xff);
-    //Send message to the module
-    port->write(output);
-
-    ros::Duration(0.015).sleep();
+    //CLEAR_ERROR, SAVE, RESET_PARA and FORCE_SENS_CALI, the firmware sets them back to 0 when it is done
+    static const uint16_t trigger[4] = { reg::CLEAR_ERROR::addr, reg::SAVE::addr, reg::RESET_PARA::addr, reg::FORCE_CLB::addr };
+    //ERROR and STATUS are adjacent, one read per poll
+    typedef register_block<reg::ERROR, reg::STATUS> state_block;
+
+    //Each poll is a few short transactions, other callers get the bus in between
+    ros::WallTime start = ros::WallTime::now();
+    while (!stopping_)
+    {
+        ros::Duration(maintenance_poll_).sleep();
+        double elapsed = (ros::WallTime::now() - start).toSec();
+
+        uint8_t flag = 1;
+        uint8_t status[6] = { 0 };
+        uint8_t error[6] = { 0 };
+        uint8_t data[state_block::bytes];
+        readBytes(port, trigger[operation], 1, &flag);
+        if (readBlock<state_block>(port, data) == TR_OK)
+            for (int i = 0; i < 6; i++)
+            {
+                status[i] = state_block::decode<reg::STATUS>(data, i);
+                error[i] = state_block::decode<reg::ERROR>(data, i);
+            }
 
-    std::string s1;
-    for (int i = 0; i<output.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", output[i]);
-        s1 = s1 + str + " ";
-    }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Write: " << s1);
+        bool done = flag == 0;
+        if (operation == MAINT_CLEAR_ERROR)
+            for (int i = 0; i < 6; i++)
+                done = done && error[i] == 0;
 
-    //Read response
-    std::vector<uint8_t> input;
-    while (input.empty())
-    {
-        port->read(input, (size_t)64);
-    }
-    std::string s2;
-    for (int i = 0; i<input.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", input[i]);
-        s2 = s2 + str + " ";
+        if (progress && !progress(elapsed, status, error))
+            return false;
+        if (done)
+        {
+            ROS_INFO("Hand: maintenance command %d done after %.3f s", operation, elapsed);
+            return true;
+        }
+        if (elapsed > maintenance_timeout_)
+        {
+            ROS_WARN("Hand: maintenance command %d not done after %.1f s", operation, elapsed);
+            return false;
+        }
     }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Read: " << s2);
-    int temp[10] = { 0 };
-    for (int j = 0; j<6; j++)
-        temp[j] = ((input[8 + j * 2] << 8) & 0xff00) + input[7 + j * 2];
-    //ROS_INFO("Gripper: No error detected");
-    ROS_INFO_STREAM("hand: current: "
-                    << temp[0]
-            << " "
-            << temp[1]
-            << " "
-            << temp[2]
-            << " "
-            << temp[3]
-            << " "
-            << temp[4]
-            << " "
-            << temp[5]
-               );
-    current_[0] = float(temp[0]);
-    current_[1] = float(temp[1]);
-    current_[2] = float(temp[2]);
-    current_[3] = float(temp[3]);
-    current_[4] = float(temp[4]);
-    current_[5] = float(temp[5]);
+    return false;
 }
 
-uint8_t
-hand_serial::getERROR(serial::Serial *port)
+void
+hand_serial::maintenanceExecute(const inspire_hand::HandMaintenanceGoalConstPtr &goal)
 {
-    std::vector<uint8_t> output;
-    //message from master to module
-    output.push_back(0xEB);
-    output.push_back(0x90);
-    //module id
-    output.push_back(hand_id_);
-    //Data Length
-    output.push_back(0x04);
-    //Command get state
-    output.push_back(0x11);
-    output.push_back(0x46);
-    output.push_back(0x06);
-    output.push_back(0x06);
-    //Checksum calculation
-    unsigned int check_num = 0;
-    int len = output[3] + 5;
-    for (int i = 2; i < len - 1; i++)
-        check_num = check_num + output[i];
-    //Add checksum to the output buffer
-    output.push_back(check_num & 0xff);
-    //Send message to the module
-    port->write(output);
-    ros::Duration(0.015).sleep();
-    std::string s1;
-    for (int i = 0; i<output.size(); ++i)
+    inspire_hand::HandMaintenanceResult result;
+    result.success = false;
+    result.elapsed = 0;
+    if (!ready_)
     {
-        char str[16];
-        sprintf(str, "%02X", output[i]);
-        s1 = s1 + str + " ";
+        result.message = "hand not ready";
+        maintenance_server_->setAborted(result, result.message);
+        return;
     }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Write: " << s1);
-    //Read response
-    std::vector<uint8_t> input;
-    while (input.empty())
+
+    //Feedback on every poll; a preempt only stops the waiting, the hand finishes the command anyway
+    bool preempted = false;
+    maintenance_progress progress = [&](double elapsed, const uint8_t *status, const uint8_t *error)
     {
-        port->read(input, (size_t)64);
+        inspire_hand::HandMaintenanceFeedback feedback;
+        feedback.elapsed = elapsed;
+        for (int i = 0; i < 6; i++)
+        {
+            feedback.status[i] = status[i];
+            feedback.error[i] = error[i];
+            result.error[i] = error[i];
+        }
+        result.elapsed = elapsed;
+        maintenance_server_->publishFeedback(feedback);
+        preempted = maintenance_server_->isPreemptRequested();
+        return !preempted;
+    };
+
+    switch (goal->operation)
+    {
+    case inspire_hand::HandMaintenanceGoal::CLEAR_ERROR:
+        result.success = setCLEAR_ERROR(com_port_, progress);
+        break;
+    case inspire_hand::HandMaintenanceGoal::SAVE_FLASH:
+        result.success = setSAVE_FLASH(com_port_, progress);
+        break;
+    case inspire_hand::HandMaintenanceGoal::RESET_PARA:
+        result.success = setRESET_PARA(com_port_, progress);
+        break;
+    case inspire_hand::HandMaintenanceGoal::FORCE_CLB:
+        result.success = setFORCE_CLB(com_port_, progress);
+        break;
+    default:
+        result.message = "unknown operation";
+        maintenance_server_->setAborted(result, result.message);
+        return;
     }
-    std::string s2;
-    for (int i = 0; i<input.size(); ++i)
+
+    if (preempted)
+        maintenance_server_->setPreempted(result, "stopped waiting");
+    else if (result.success)
+        maintenance_server_->setSucceeded(result);
+    else
     {
-        char str[16];
-        sprintf(str, "%02X", input[i]);
-        s2 = s2 + str + " ";
+        result.message = "not acknowledged or not done in time";
+        maintenance_server_->setAborted(result, result.message);
     }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Read: " << s2);
-    int temp[10] = { 0 };
-    for (int j = 0; j<6; j++)
-        temp[j] = input[7 + j];
-    //ROS_INFO("Gripper: No error detected");
-    ROS_INFO_STREAM("hand: error: "
-                    << temp[0]
-            << " "
-            << temp[1]
-            << " "
-            << temp[2]
-            << " "
-            << temp[3]
-            << " "
-            << temp[4]
-            << " "
-            << temp[5]
-               );
-    errorvalue_[0] = float(temp[0]);
-    errorvalue_[1] = float(temp[1]);
-    errorvalue_[2] = float(temp[2]);
-    errorvalue_[3] = float(temp[3]);
-    errorvalue_[4] = float(temp[4]);
-    errorvalue_[5] = float(temp[5]);
-    if (errorvalue_[0] == 0 && errorvalue_[1] == 0 &&errorvalue_[2] == 0 &&errorvalue_[3] == 0 &&errorvalue_[4] == 0 &&errorvalue_[5] == 0)
-        return((uint8_t)0x00);
-    else
-        return((uint8_t)0xff);
 }
 
-void
-hand_serial::getSTATUS(serial::Serial *port)
+bool
+hand_serial::loadProfile(const std::string &name, config_profile &profile)
 {
-    std::vector<uint8_t> output;
-    //message from master to module
-    output.push_back(0xEB);
-    output.push_back(0x90);
-    //module id
-    output.push_back(hand_id_);
-    //Data Length
-    output.push_back(0x04);
-    //Command get state
-    output.push_back(0x11);
-    output.push_back(0x4C);
-    output.push_back(0x06);
-    output.push_back(0x06);
-    //Checksum calculation
-    unsigned int check_num = 0;
-    int len = output[3] + 5;
-    for (int i = 2; i < len - 1; i++)
-        check_num = check_num + output[i];
-    //Add checksum to the output buffer
-    output.push_back(check_num & 0xff);
-    //Send message to the module
-    port->write(output);
-
-    ros::Duration(0.015).sleep();
+    std::string base = "inspire_hand/profiles/" + name;
+    if (!param_nh_.hasParam(base))
+        return false;
 
-    std::string s1;
-    for (int i = 0; i<output.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", output[i]);
-        s1 = s1 + str + " ";
-    }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Write: " << s1);
+    for (int r = 0; r < 18; r++)
+        profile.defaults[r] = -1;
+    profile.user_angles.clear();
 
-    //Read response
-    std::vector<uint8_t> input;
-    while (input.empty())
+    //Each block is optional, a missing one is left as it is on the hand
+    const char *blocks[3] = { "current_limit", "default_speed", "default_force" };
+    for (int b = 0; b < 3; b++)
     {
-        port->read(input, (size_t)64);
+        std::vector<int> values;
+        if (!param_nh_.getParam(base + "/" + blocks[b], values))
+            continue;
+        if (values.size() != 6)
+        {
+            ROS_WARN_STREAM("Hand: profile " << name << ": " << blocks[b] << " needs 6 values");
+            return false;
+        }
+        bool in_range = b == 0 ? checkRange<reg::CURRENT_LIMIT>(&values[0], 6)
+                       : b == 1 ? checkRange<reg::DEFAULT_SPEED>(&values[0], 6)
+                       : checkRange<reg::DEFAULT_FORCE>(&values[0], 6);
+        if (!in_range)
+            return false;
+        for (int i = 0; i < 6; i++)
+            profile.defaults[b * 6 + i] = values[i];
     }
 
-    std::string s2;
-    for (int i = 0; i<input.size(); ++i)
+    //user_def_angle: { 14: [a0, .. a5], 15: [...] }
+    XmlRpc::XmlRpcValue gestures;
+    if (param_nh_.getParam(base + "/user_def_angle", gestures))
     {
-        char str[16];
-        sprintf(str, "%02X", input[i]);
-        s2 = s2 + str + " ";
+        if (gestures.getType() != XmlRpc::XmlRpcValue::TypeStruct)
+        {
+            ROS_WARN_STREAM("Hand: profile " << name << ": user_def_angle must map gesture numbers to angles");
+            return false;
+        }
+        for (XmlRpc::XmlRpcValue::iterator it = gestures.begin(); it != gestures.end(); ++it)
+        {
+            int k = atoi(it->first.c_str());
+            XmlRpc::XmlRpcValue &angles = it->second;
+            if (k < 14 || k > 45 || angles.getType() != XmlRpc::XmlRpcValue::TypeArray || angles.size() != 6)
+            {
+                ROS_WARN_STREAM("Hand: profile " << name << ": bad user_def_angle entry " << it->first);
+                return false;
+            }
+            std::vector<int> values;
+            for (int i = 0; i < 6; i++)
+                values.push_back(static_cast<int>(angles[i]));
+            if (!checkRange<reg::USER_DEF_ANGLE>(&values[0], 6))
+                return false;
+            profile.user_angles[k] = values;
+        }
     }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Read: " << s2);
-
-    int temp[10] = { 0 };
-    for (int j = 0; j<6; j++)
-        temp[j] = input[7 + j];
-    //ROS_INFO("Gripper: No status detected");
-    ROS_INFO_STREAM("hand: status: "
-                    << temp[0]
-            << " "
-            << temp[1]
-            << " "
-            << temp[2]
-            << " "
-            << temp[3]
-            << " "
-            << temp[4]
-            << " "
-            << temp[5]
-               );
-    statusvalue_[0] = float(temp[0]);
-    statusvalue_[1] = float(temp[1]);
-    statusvalue_[2] = float(temp[2]);
-    statusvalue_[3] = float(temp[3]);
-    statusvalue_[4] = float(temp[4]);
-    statusvalue_[5] = float(temp[5]);
+    return true;
 }
 
-void
-hand_serial::getTEMP(serial::Serial *port)
+bool
+hand_serial::applyProfile(serial::Serial *port, const config_profile &profile, bool save, int &written, bool &saved)
 {
-    std::vector<uint8_t> output;
-    //message from master to module
-    output.push_back(0xEB);
-    output.push_back(0x90);
-    //module id
-    output.push_back(hand_id_);
-    //Data Length
-    output.push_back(0x04);
-    //Command get state
-    output.push_back(0x11);
-    output.push_back(0x52);
-    output.push_back(0x06);
-    output.push_back(0x06);
-    //Checksum calculation
-    unsigned int check_num = 0;
-    int len = output[3] + 5;
-    for (int i = 2; i < len - 1; i++)
-        check_num = check_num + output[i];
-    //Add checksum to the output buffer
-    output.push_back(check_num & 0xff);
-    //Send message to the module
-    port->write(output);
-
-    ros::Duration(0.015).sleep();
+    written = 0;
+    saved = false;
+
+    //Diff against what the hand holds now, unchanged registers are not written and do not wear the flash
+    std::vector<std::vector<uint8_t> > frames;
+    std::vector<std::pair<int, int> > spans;
+
+    bool any_default = false;
+    for (int r = 0; r < 18; r++)
+        any_default = any_default || profile.defaults[r] >= 0;
+    if (any_default)
+    {
+        //CURRENT_LIMIT, DEFAULT_SPEED and DEFAULT_FORCE are contiguous, one read covers all three
+        typedef register_block<reg::CURRENT_LIMIT, reg::DEFAULT_SPEED, reg::DEFAULT_FORCE> defaults_block;
+        static_assert(defaults_block::bytes == 18 * 2, "defaults are not one block");
+        uint8_t data[defaults_block::bytes];
+        int current[18];
+        bool dirty[18];
+        if (readBlock<defaults_block>(port, data) != TR_OK)
+            return false;
+        for (int r = 0; r < 18; r++)
+        {
+            current[r] = r < 6 ? defaults_block::decode<reg::CURRENT_LIMIT>(data, r)
+                       : r < 12 ? defaults_block::decode<reg::DEFAULT_SPEED>(data, r - 6)
+                       : defaults_block::decode<reg::DEFAULT_FORCE>(data, r - 12);
+            dirty[r] = profile.defaults[r] >= 0 && profile.defaults[r] != current[r];
+            written += dirty[r];
+        }
+        appendDirtyFrames(frames, spans, defaults_block::addr, profile.defaults, dirty, 18, current);
+    }
 
-    std::string s1;
-    for (int i = 0; i<output.size(); ++i)
+    for (std::map<int, std::vector<int> >::const_iterator it = profile.user_angles.begin(); it != profile.user_angles.end(); ++it)
     {
-        char str[16];
-        sprintf(str, "%02X", output[i]);
-        s1 = s1 + str + " ";
+        //Gestures 14-45 hold six angles each
+        int first = (it->first - 14) * 6;
+        int current[6];
+        bool dirty[6];
+        if (readRegister<reg::USER_DEF_ANGLE>(port, current, first, 6) != TR_OK)
+            return false;
+        for (int i = 0; i < 6; i++)
+        {
+            dirty[i] = it->second[i] != current[i];
+            written += dirty[i];
+        }
+        appendDirtyFrames(frames, spans, reg::USER_DEF_ANGLE::addr + first * reg::USER_DEF_ANGLE::width,
+                          &it->second[0], dirty, 6, current);
     }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Write: " << s1);
 
-    //Read response
-    std::vector<uint8_t> input;
-    while (input.empty())
+    if (frames.empty())
+        return true;
+
+    std::vector<bool> acked;
+    if (!transactionBatch(port, frames, 0.015, acked))
     {
-        port->read(input, (size_t)64);
+        ROS_WARN("Hand: profile write not acknowledged, flash not saved");
+        return false;
     }
 
-    std::string s2;
-    for (int i = 0; i<input.size(); ++i)
+    if (save)
     {
-        char str[16];
-        sprintf(str, "%02X", input[i]);
-        s2 = s2 + str + " ";
+        saved = setSAVE_FLASH(port);
+        return saved;
     }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Read: " << s2);
-
-    int temp[10] = { 0 };
-    for (int j = 0; j<6; j++)
-        temp[j] = input[7 + j];
-    //ROS_INFO("Gripper: No temp detected");
-    ROS_INFO_STREAM("hand: temp: "
-                    << temp[0]
-            << " "
-            << temp[1]
-            << " "
-            << temp[2]
-            << " "
-            << temp[3]
-            << " "
-            << temp[4]
-            << " "
-            << temp[5]
-               );
-    tempvalue_[0] = float(temp[0]);
-    tempvalue_[1] = float(temp[1]);
-    tempvalue_[2] = float(temp[2]);
-    tempvalue_[3] = float(temp[3]);
-    tempvalue_[4] = float(temp[4]);
-    tempvalue_[5] = float(temp[5]);
+    return true;
 }
 
 void
-hand_serial::getPOS_SET(serial::Serial *port)
+hand_serial::updateShadow(int field, const int *value, bool acked)
 {
-    std::vector<uint8_t> output;
-    //message from master to module
-    output.push_back(0xEB);
-    output.push_back(0x90);
-    //module id
-    output.push_back(hand_id_);
-    //Data Length
-    output.push_back(0x04);
-    //Command get state
-    output.push_back(0x11);
-    output.push_back(0xC2);
-    output.push_back(0x05);
-    output.push_back(0x0C);
-    //Checksum calculation
-    unsigned int check_num = 0;
-    int len = output[3] + 5;
-    for (int i = 2; i < len - 1; i++)
-        check_num = check_num + output[i];
-    //Add checksum to the output buffer
-    output.push_back(check_num & 0xff);
-    //Send message to the module
-    port->write(output);
-
-    ros::Duration(0.015).sleep();
-
-    std::string s1;
-    for (int i = 0; i<output.size(); ++i)
+    std::lock_guard<std::mutex> lock(setpoint_mutex_);
+    for (int i = 0; i < 6; i++)
     {
-        char str[16];
-        sprintf(str, "%02X", output[i]);
-        s1 = s1 + str + " ";
+        if (value[i] < 0)
+            continue;
+        //Without an ack the hand may or may not have taken the value
+        setpoint_shadow_[field][i] = acked ? value[i] : -1;
     }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Write: " << s1);
+}
 
-    //Read response
-    std::vector<uint8_t> input;
-    while (input.empty())
-    {
-        port->read(input, (size_t)64);
-    }
+void
+hand_serial::invalidateShadow(int field)
+{
+    for (int i = 0; i < 6; i++)
+        setpoint_shadow_[field][i] = -1;
+}
 
-    std::string s2;
-    for (int i = 0; i<input.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", input[i]);
-        s2 = s2 + str + " ";
-    }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Read: " << s2);
+transaction_result
+hand_serial::getPOS_ACT(serial::Serial *port)
+{
+    int temp[6] = { 0 };
+    transaction_result result = readRegister<reg::POS_ACT>(port, temp);
+    if (result != TR_OK)
+        return result;
+    ROS_INFO_STREAM("hand: current pos: "
+                    << temp[0] << " " << temp[1] << " " << temp[2] << " "
+                    << temp[3] << " " << temp[4] << " " << temp[5]);
+    for (int j = 0; j < 6; j++)
+        curpos_[j] = float(temp[j]);
+    return TR_OK;
+}
 
-    int temp[10] = { 0 };
-    for (int j = 0; j<6; j++)
-        temp[j] = ((input[8 + j * 2] << 8) & 0xff00) + input[7 + j * 2];
-    //ROS_INFO("Gripper: No error detected");
-    ROS_INFO_STREAM("hand: set pos: "
-                    << temp[0]
-            << " "
-            << temp[1]
-            << " "
-            << temp[2]
-            << " "
-            << temp[3]
-            << " "
-            << temp[4]
-            << " "
-            << temp[5]
-               );
-    setpos_[0] = float(temp[0]);
-    setpos_[1] = float(temp[1]);
-    setpos_[2] = float(temp[2]);
-    setpos_[3] = float(temp[3]);
-    setpos_[4] = float(temp[4]);
-    setpos_[5] = float(temp[5]);
+transaction_result
+hand_serial::getANGLE_ACT(serial::Serial *port)
+{
+    int temp[6] = { 0 };
+    transaction_result result = readRegister<reg::ANGLE_ACT>(port, temp);
+    if (result != TR_OK)
+        return result;
+    storeState(curangle_, temp);
+    return TR_OK;
 }
 
-void
-hand_serial::getANGLE_SET(serial::Serial *port)
+
+transaction_result
+hand_serial::getFORCE_ACT(serial::Serial *port)
 {
-    std::vector<uint8_t> output;
-    //message from master to module
-    output.push_back(0xEB);
-    output.push_back(0x90);
-    //module id
-    output.push_back(hand_id_);
-    //Data Length
-    output.push_back(0x04);
-    //Command get state
-    output.push_back(0x11);
-    output.push_back(0xCE);
-    output.push_back(0x05);
-    output.push_back(0x0C);
-    //Checksum calculation
-    unsigned int check_num = 0;
-    int len = output[3] + 5;
-    for (int i = 2; i < len - 1; i++)
-        check_num = check_num + output[i];
-    //Add checksum to the output buffer
-    output.push_back(check_num & 0xff);
-    //Send message to the module
-    port->write(output);
-    ros::Duration(0.015).sleep();
+    int temp[6] = { 0 };
+    transaction_result result = readRegister<reg::FORCE_ACT>(port, temp);
+    if (result != TR_OK)
+        return result;
+    storeState(curforce_, temp);
+    return TR_OK;
+}
 
-    std::string s1;
-    for (int i = 0; i<output.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", output[i]);
-        s1 = s1 + str + " ";
-    }
+transaction_result
+hand_serial::getCURRENT(serial::Serial *port)
+{
+    int temp[6] = { 0 };
+    transaction_result result = readRegister<reg::CURRENT>(port, temp);
+    if (result != TR_OK)
+        return result;
     if (test_flags == 1)
-        ROS_INFO_STREAM("Write: " << s1);
-    //Read response
-    std::vector<uint8_t> input;
-    while (input.empty())
-    {
-        port->read(input, (size_t)64);
-    }
+        ROS_INFO_STREAM("hand: current: "
+                        << temp[0] << " " << temp[1] << " " << temp[2] << " "
+                        << temp[3] << " " << temp[4] << " " << temp[5]);
+    storeState(current_, temp);
+    return TR_OK;
+}
 
-    std::string s2;
-    for (int i = 0; i<input.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", input[i]);
-        s2 = s2 + str + " ";
-    }
+uint8_t
+hand_serial::getERROR(serial::Serial *port)
+{
+    int temp[6] = { 0 };
+    if (readRegister<reg::ERROR>(port, temp) != TR_OK)
+        return 0xff;
     if (test_flags == 1)
-        ROS_INFO_STREAM("Read: " << s2);
-    int temp[10] = { 0 };
-    for (int j = 0; j<6; j++)
-        temp[j] = ((input[8 + j * 2] << 8) & 0xff00) + input[7 + j * 2];
-    //ROS_INFO("Gripper: No error detected");
-    ROS_INFO_STREAM("hand: set angle: "
-                    << temp[0]
-            << " "
-            << temp[1]
-            << " "
-            << temp[2]
-            << " "
-            << temp[3]
-            << " "
-            << temp[4]
-            << " "
-            << temp[5]
-               );
-    setangle_[0] = float(temp[0]);
-    setangle_[1] = float(temp[1]);
-    setangle_[2] = float(temp[2]);
-    setangle_[3] = float(temp[3]);
-    setangle_[4] = float(temp[4]);
-    setangle_[5] = float(temp[5]);
+        ROS_INFO_STREAM("hand: error: "
+                        << temp[0] << " " << temp[1] << " " << temp[2] << " "
+                        << temp[3] << " " << temp[4] << " " << temp[5]);
+    storeState(errorvalue_, temp);
+    bool any = false;
+    for (int j = 0; j < 6; j++)
+        any = any || temp[j] != 0;
+    return any ? 0xff : 0x00;
+}
+
+transaction_result
+hand_serial::getSTATUS(serial::Serial *port)
+{
+    int temp[6] = { 0 };
+    transaction_result result = readRegister<reg::STATUS>(port, temp);
+    if (result != TR_OK)
+        return result;
+    if (test_flags == 1)
+        ROS_INFO_STREAM("hand: status: "
+                        << temp[0] << " " << temp[1] << " " << temp[2] << " "
+                        << temp[3] << " " << temp[4] << " " << temp[5]);
+    storeState(statusvalue_, temp);
+    return TR_OK;
+}
+
+transaction_result
+hand_serial::getTEMP(serial::Serial *port)
+{
+    int temp[6] = { 0 };
+    transaction_result result = readRegister<reg::TEMP>(port, temp);
+    if (result != TR_OK)
+        return result;
+    if (test_flags == 1)
+        ROS_INFO_STREAM("hand: temp: "
+                        << temp[0] << " " << temp[1] << " " << temp[2] << " "
+                        << temp[3] << " " << temp[4] << " " << temp[5]);
+    storeState(tempvalue_, temp);
+    return TR_OK;
 }
 
 void
-hand_serial::getFORCE_SET(serial::Serial *port)
+hand_serial::storeState(float *state, const int *value)
 {
-    std::vector<uint8_t> output;
-    //message from master to module
-    output.push_back(0xEB);
-    output.push_back(0x90);
-    //module id
-    output.push_back(hand_id_);
-    //Data Length
-    output.push_back(0x04);
-    //Command get state
-    output.push_back(0x11);
-    output.push_back(0xDA);
-    output.push_back(0x05);
-    output.push_back(0x0C);
-    //Checksum calculation
-    unsigned int check_num = 0;
-    int len = output[3] + 5;
-    for (int i = 2; i < len - 1; i++)
-        check_num = check_num + output[i];
-    //Add checksum to the output buffer
-    output.push_back(check_num & 0xff);
-    //Send message to the module
-    port->write(output);
+    std::lock_guard<std::mutex> lock(state_mutex_);
+    for (int j = 0; j < 6; j++)
+        state[j] = float(value[j]);
+}
 
-    ros::Duration(0.015).sleep();
+void
+hand_serial::snapshotState(state_snapshot &out)
+{
+    std::lock_guard<std::mutex> lock(state_mutex_);
+    memcpy(out.angle, curangle_, sizeof(out.angle));
+    memcpy(out.force, curforce_, sizeof(out.force));
+    memcpy(out.current, current_, sizeof(out.current));
+    memcpy(out.status, statusvalue_, sizeof(out.status));
+    memcpy(out.error, errorvalue_, sizeof(out.error));
+    memcpy(out.temp, tempvalue_, sizeof(out.temp));
+}
 
-    std::string s1;
-    for (int i = 0; i<output.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", output[i]);
-        s1 = s1 + str + " ";
-    }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Write: " << s1);
-    //Read response
-    std::vector<uint8_t> input;
-    while (input.empty())
-    {
-        port->read(input, (size_t)64);
-    }
+transaction_result
+hand_serial::getPOS_SET(serial::Serial *port)
+{
+    int temp[6] = { 0 };
+    transaction_result result = readRegister<reg::POS_SET>(port, temp);
+    if (result != TR_OK)
+        return result;
+    ROS_INFO_STREAM("hand: set pos: "
+                    << temp[0] << " " << temp[1] << " " << temp[2] << " "
+                    << temp[3] << " " << temp[4] << " " << temp[5]);
+    for (int j = 0; j < 6; j++)
+        setpos_[j] = float(temp[j]);
+    return TR_OK;
+}
 
-    std::string s2;
-    for (int i = 0; i<input.size(); ++i)
-    {
-        char str[16];
-        sprintf(str, "%02X", input[i]);
-        s2 = s2 + str + " ";
-    }
-    if (test_flags == 1)
-        ROS_INFO_STREAM("Read: " << s2);
-    int temp[10] = { 0 };
-    for (int j = 0; j<6; j++)
-        temp[j] = ((input[8 + j * 2] << 8) & 0xff00) + input[7 + j * 2];
-    //ROS_INFO("Gripper: No error detected");
+transaction_result
+hand_serial::getANGLE_SET(serial::Serial *port)
+{
+    int temp[6] = { 0 };
+    transaction_result result = readRegister<reg::ANGLE_SET>(port, temp);
+    if (result != TR_OK)
+        return result;
+    ROS_INFO_STREAM("hand: set angle: "
+                    << temp[0] << " " << temp[1] << " " << temp[2] << " "
+                    << temp[3] << " " << temp[4] << " " << temp[5]);
+    for (int j = 0; j < 6; j++)
+        setangle_[j] = float(temp[j]);
+    return TR_OK;
+}
+
+transaction_result
+hand_serial::getFORCE_SET(serial::Serial *port)
+{
+    int temp[6] = { 0 };
+    transaction_result result = readRegister<reg::FORCE_SET>(port, temp);
+    if (result != TR_OK)
+        return result;
     ROS_INFO_STREAM("hand: set force: "
-                    << temp[0]
-            << " "
-            << temp[1]
-            << " "
-            << temp[2]
-            << " "
-            << temp[3]
-            << " "
-            << temp[4]
-            << " "
-            << temp[5]
-               );
-    setforce_[0] = float(temp[0]);
-    setforce_[1] = float(temp[1]);
-    setforce_[2] = float(temp[2]);
-    setforce_[3] = float(temp[3]);
-    setforce_[4] = float(temp[4]);
-    setforce_[5] = float(temp[5]);
+                    << temp[0] << " " << temp[1] << " " << temp[2] << " "
+                    << temp[3] << " " << temp[4] << " " << temp[5]);
+    for (int j = 0; j < 6; j++)
+        setforce_[j] = float(temp[j]);
+    return TR_OK;
 }
 
 //bool
@@ -2864,6 +2368,126 @@ hand_serial::getFORCE_SET(serial::Serial *port)
 //}
 
 
+void
+hand_serial::advertise(ros::NodeHandle *nh)
+{
+    advertiseGated(nh, "inspire_hand/set_id", &hand_serial::setIDCallback);
+    advertiseGated(nh, "inspire_hand/set_redu_ratio", &hand_serial::setREDU_RATIOCallback);
+    advertiseGated(nh, "inspire_hand/set_clear_error", &hand_serial::setCLEAR_ERRORCallback);
+    advertiseGated(nh, "inspire_hand/set_save_flash", &hand_serial::setSAVE_FLASHCallback);
+    advertiseGated(nh, "inspire_hand/set_reset_para", &hand_serial::setRESET_PARACallback);
+    advertiseGated(nh, "inspire_hand/set_force_clb", &hand_serial::setFORCE_CLBCallback);
+    advertiseGated(nh, "inspire_hand/set_gesture_no", &hand_serial::setGESTURE_NOCallback);
+    advertiseGated(nh, "inspire_hand/set_current_limit", &hand_serial::setCURRENT_LIMITCallback);
+    advertiseGated(nh, "inspire_hand/set_default_speed", &hand_serial::setDEFAULT_SPEEDCallback);
+    advertiseGated(nh, "inspire_hand/set_default_force", &hand_serial::setDEFAULT_FORCECallback);
+    advertiseGated(nh, "inspire_hand/set_user_def_angle", &hand_serial::setUSER_DEF_ANGLECallback);
+    advertiseGated(nh, "inspire_hand/set_pos", &hand_serial::setPOSCallback);
+    advertiseGated(nh, "inspire_hand/set_angle", &hand_serial::setANGLECallback);
+    advertiseGated(nh, "inspire_hand/set_force", &hand_serial::setFORCECallback);
+    advertiseGated(nh, "inspire_hand/set_speed", &hand_serial::setSPEEDCallback);
+    advertiseGated(nh, "inspire_hand/set_setpoint", &hand_serial::setSETPOINTCallback);
+    advertiseGated(nh, "inspire_hand/apply_profile", &hand_serial::applyPROFILECallback);
+    advertiseGated(nh, "inspire_hand/get_pos_act", &hand_serial::getPOS_ACTCallback);
+    advertiseGated(nh, "inspire_hand/get_angle_act", &hand_serial::getANGLE_ACTCallback);
+    advertiseGated(nh, "inspire_hand/get_force_act", &hand_serial::getFORCE_ACTCallback);
+    advertiseGated(nh, "inspire_hand/get_current", &hand_serial::getCURRENTCallback);
+    advertiseGated(nh, "inspire_hand/get_error", &hand_serial::getERRORCallback);
+    advertiseGated(nh, "inspire_hand/get_status", &hand_serial::getSTATUSCallback);
+    advertiseGated(nh, "inspire_hand/get_temp", &hand_serial::getTEMPCallback);
+    advertiseGated(nh, "inspire_hand/get_pos_set", &hand_serial::getPOS_SETCallback);
+    advertiseGated(nh, "inspire_hand/get_angle_set", &hand_serial::getANGLE_SETCallback);
+    advertiseGated(nh, "inspire_hand/get_force_set", &hand_serial::getFORCE_SETCallback);
+    advertiseGated(nh, "inspire_hand/query_history", &hand_serial::queryHistoryCallback);
+
+    //Polling and stats are served by the I/O thread, commands by their own thread, services stay on
+    //the caller's spinner
+    ros::NodeHandle io_nh(*nh);
+    io_nh.setCallbackQueue(&io_queue_);
+    ros::NodeHandle command_nh(*nh);
+    command_nh.setCallbackQueue(&command_queue_);
+
+    //Setpoint commands; the topic front-ends forward to this instead of opening the port themselves
+    command_sub_ = command_nh.subscribe("inspire_hand/command", 10, &hand_serial::commandCallback, this);
+
+    //Local producers can skip the topic and append to a shared-memory ring instead. The ring is
+    //checked at the active poll rate even while polling idles, so a first target is not held back
+    std::string command_shm_name;
+    param_nh_.getParam("inspire_hand/command_shm_name", command_shm_name);
+    if (!command_shm_name.empty() && pollPeriod() <= 0)
+        ROS_ERROR("Hand: command_shm_name needs a poll loop, poll_rate is 0");
+    else if (!command_shm_name.empty())
+    {
+        //The ring is private to the driver's user unless command_shm_group lets a producer group in
+        std::string command_shm_group;
+        param_nh_.getParam("inspire_hand/command_shm_group", command_shm_group);
+        int group = -1;
+        if (!command_shm_group.empty())
+        {
+            struct group *entry = getgrnam(command_shm_group.c_str());
+            if (entry != NULL)
+                group = int(entry->gr_gid);
+            else
+                ROS_ERROR_STREAM("Hand: unknown group " << command_shm_group << ", command ring stays private");
+        }
+        if (command_shm_.open(command_shm_name, group))
+        {
+            ROS_INFO_STREAM("Hand: taking commands from shared memory " << command_shm_name);
+            shm_command_timer_ = command_nh.createTimer(ros::Duration(pollPeriod()), &hand_serial::shmCommandCallback, this);
+        }
+        else
+            ROS_ERROR_STREAM("Hand: cannot create shared memory " << command_shm_name);
+    }
+    command_stats_pub = nh->advertise<inspire_hand::CommandStats>("inspire_hand/command_stats", 10);
+    bus_stats_pub = nh->advertise<inspire_hand::BusStats>("inspire_hand/bus_stats", 10);
+    thermal_pub = nh->advertise<inspire_hand::HandThermal>("inspire_hand/thermal", 10);
+
+    //Latency histograms of every register operation and service, for fleet-wide tail tracking
+    diagnostics_pub = nh->advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 10);
+    if (metrics_period_ > 0)
+        metrics_timer_ = nh->createTimer(ros::Duration(metrics_period_), &hand_serial::metricsTimerCallback, this);
+    stats_timer_ = io_nh.createTimer(ros::Duration(1.0), &hand_serial::statsTimerCallback, this);
+
+    //Poll FORCE_ACT in the driver and publish contact edges, clients no longer poll get_force_act
+    contact_pub = nh->advertise<inspire_hand::ContactEvent>("inspire_hand/contact_events", 100);
+    state_pub = nh->advertise<inspire_hand::HandState>("inspire_hand/state", 10);
+    if (pollPeriod() > 0)
+        poll_timer_ = io_nh.createTimer(ros::Duration(pollPeriod()), &hand_serial::pollTimerCallback, this);
+    io_thread_ = std::thread(&hand_serial::ioLoop, this);
+    command_thread_ = std::thread(&hand_serial::commandLoop, this);
+
+    //CLEAR_ERROR, SAVE_FLASH, RESET_PARA and FORCE_CLB without blocking the spinner; runs on the server's own thread
+    maintenance_server_.reset(new maintenance_server(*nh, "inspire_hand/maintenance",
+                                                     boost::bind(&hand_serial::maintenanceExecute, this, _1), false));
+    maintenance_server_->start();
+
+    //Latched, late subscribers still see the current bring-up state. bringUp() may already be
+    //publishing through health_pub, so it is only set under health_mutex_
+    {
+        std::lock_guard<std::mutex> lock(health_mutex_);
+        health_pub = nh->advertise<inspire_hand::HandHealth>("inspire_hand/health", 1, true);
+    }
+    publishHealth();
+}
+
+void
+hand_serial::ioLoop()
+{
+    while (!stopping_ && ros::ok())
+        io_queue_.callAvailable(ros::WallDuration(0.1));
+}
+
+void
+hand_serial::commandLoop()
+{
+    //Everything that arrived while the last write held the bus is coalesced into the next one
+    while (!stopping_ && ros::ok())
+    {
+        command_queue_.callAvailable(ros::WallDuration(0.1));
+        applyCommands();
+    }
+}
+
 /////////////////////////////////////////////////////////////
 //CALLBACKS
 /////////////////////////////////////////////////////////////
@@ -2881,6 +2505,7 @@ hand_serial::setIDCallback(inspire_hand::set_id::Request &req,
         ROS_INFO("Hand: error id([1 254])!");
         res.idgrab = false;
     }
+    return true;
 }
 
 bool
@@ -2897,6 +2522,7 @@ hand_serial::setREDU_RATIOCallback(inspire_hand::set_redu_ratio::Request &req,
         ROS_INFO("Hand: error redu_ratio([0 2])!");
         res.redu_ratiograb = false;
     }
+    return true;
 }
 
 bool
@@ -2905,6 +2531,7 @@ hand_serial::setCLEAR_ERRORCallback(inspire_hand::set_clear_error::Request &req,
 {
     ROS_INFO("Hand: clear error Cmd recieved ");
     res.setclear_error_accepted = setCLEAR_ERROR(com_port_);
+    return true;
 }
 
 bool
@@ -2913,6 +2540,7 @@ hand_serial::setSAVE_FLASHCallback(inspire_hand::set_save_flash::Request &req,
 {
     ROS_INFO("Hand: save para to flash Cmd recieved ");
     res.setsave_flash_accepted = setSAVE_FLASH(com_port_);
+    return true;
 }
 
 bool
@@ -2921,6 +2549,7 @@ hand_serial::setRESET_PARACallback(inspire_hand::set_reset_para::Request &req,
 {
     ROS_INFO("Hand: reset para Cmd recieved ");
     res.setreset_para_accepted = setRESET_PARA(com_port_);
+    return true;
 }
 
 bool
@@ -2929,6 +2558,7 @@ hand_serial::setFORCE_CLBCallback(inspire_hand::set_force_clb::Request &req,
 {
     ROS_INFO("Hand:gesture force clb Cmd recieved ");
     res.setforce_clb_accepted = setFORCE_CLB(com_port_);
+    return true;
 }
 
 bool
@@ -2945,6 +2575,7 @@ hand_serial::setGESTURE_NOCallback(inspire_hand::set_gesture_no::Request &req,
         ROS_INFO("Hand: error gesture_no([0 45])!");
         res.gesture_nograb = false;
     }
+    return true;
 }
 
 bool
@@ -2969,6 +2600,7 @@ hand_serial::setCURRENT_LIMITCallback(inspire_hand::set_current_limit::Request &
         ROS_WARN("Hand: current error!");
         res.current_limit_accepted = false;
     }
+    return true;
 }
 
 bool
@@ -2993,6 +2625,7 @@ hand_serial::setDEFAULT_SPEEDCallback(inspire_hand::set_default_speed::Request &
         ROS_WARN("Hand: speed error!");
         res.default_speed_accepted = false;
     }
+    return true;
 }
 
 bool
@@ -3017,6 +2650,7 @@ hand_serial::setDEFAULT_FORCECallback(inspire_hand::set_default_force::Request &
         ROS_WARN("Hand: force error!");
         res.default_force_accepted = false;
     }
+    return true;
 }
 
 bool
@@ -3052,6 +2686,7 @@ hand_serial::setUSER_DEF_ANGLECallback(inspire_hand::set_user_def_angle::Request
         ROS_WARN("Hand: angle error!");
         res.angle_accepted = false;
     }
+    return true;
 }
 
 bool
@@ -3076,6 +2711,7 @@ hand_serial::setPOSCallback(inspire_hand::set_pos::Request &req,
         ROS_WARN("Hand: pos error!");
         res.pos_accepted = false;
     }
+    return true;
 }
 
 bool
@@ -3100,6 +2736,7 @@ hand_serial::setANGLECallback(inspire_hand::set_angle::Request &req,
         ROS_WARN("Hand: angle error!");
         res.angle_accepted = false;
     }
+    return true;
 }
 
 bool
@@ -3124,6 +2761,7 @@ hand_serial::setFORCECallback(inspire_hand::set_force::Request &req,
         ROS_WARN("Hand: force error!");
         res.force_accepted = false;
     }
+    return true;
 }
 
 bool
@@ -3150,6 +2788,55 @@ hand_serial::setSPEEDCallback(inspire_hand::set_speed::Request &req,
         ROS_WARN("Hand: speed error!");
         res.speed_accepted = false;
     }
+    return true;
+}
+
+bool
+hand_serial::setSETPOINTCallback(inspire_hand::set_setpoint::Request &req,
+                                 inspire_hand::set_setpoint::Response &res)
+{
+    ROS_INFO("hand: set setpoint");
+    //-1 leaves a value unchanged, a field that is -1 for every DOF is not sent at all
+    setpoint_targets targets;
+    targets.clear();
+    for (int i = 0; i < 6; i++)
+    {
+        if (req.angle[i] < -1 || req.angle[i] > 1000 ||
+            req.force[i] < -1 || req.force[i] > 1000 ||
+            req.speed[i] < -1 || req.speed[i] > 1000)
+        {
+            ROS_WARN("Hand: setpoint error!");
+            res.setpoint_accepted = false;
+            return true;
+        }
+        targets.value[SP_ANGLE][i] = req.angle[i];
+        targets.value[SP_FORCE][i] = req.force[i];
+        targets.value[SP_SPEED][i] = req.speed[i];
+    }
+    res.setpoint_accepted = setSETPOINTS(com_port_, targets);
+    return true;
+}
+
+bool
+hand_serial::applyPROFILECallback(inspire_hand::apply_profile::Request &req,
+                                  inspire_hand::apply_profile::Response &res)
+{
+    ROS_INFO_STREAM("hand: apply profile " << req.name);
+    config_profile profile;
+    res.registers_written = 0;
+    res.saved = false;
+    if (!loadProfile(req.name, profile))
+    {
+        ROS_WARN_STREAM("Hand: profile " << req.name << " not found or invalid!");
+        res.profile_accepted = false;
+        return true;
+    }
+    int written;
+    bool saved;
+    res.profile_accepted = applyProfile(com_port_, profile, req.save, written, saved);
+    res.registers_written = written;
+    res.saved = saved;
+    return true;
 }
 
 bool
@@ -3157,13 +2844,15 @@ hand_serial::getPOS_ACTCallback(inspire_hand::get_pos_act::Request &req,
                                 inspire_hand::get_pos_act::Response &res)
 {
     ROS_INFO("Hand: Get act pos request recieved");
-    getPOS_ACT(com_port_);
+    if (getPOS_ACT(com_port_) != TR_OK)
+        return false;
     res.curpos[0] = curpos_[0];
     res.curpos[1] = curpos_[1];
     res.curpos[2] = curpos_[2];
     res.curpos[3] = curpos_[3];
     res.curpos[4] = curpos_[4];
     res.curpos[5] = curpos_[5];
+    return true;
 }
 
 bool
@@ -3171,13 +2860,16 @@ hand_serial::getANGLE_ACTCallback(inspire_hand::get_angle_act::Request &req,
                                   inspire_hand::get_angle_act::Response &res)
 {
     ROS_INFO("Hand: Get act angle request recieved");
-    getANGLE_ACT(com_port_);
+    if (getANGLE_ACT(com_port_) != TR_OK)
+        return false;
+    std::lock_guard<std::mutex> lock(state_mutex_);
     res.curangle[0] = curangle_[0];
     res.curangle[1] = curangle_[1];
     res.curangle[2] = curangle_[2];
     res.curangle[3] = curangle_[3];
     res.curangle[4] = curangle_[4];
     res.curangle[5] = curangle_[5];
+    return true;
 }
 
 bool
@@ -3186,13 +2878,16 @@ hand_serial::getFORCE_ACTCallback(inspire_hand::get_force_act::Request &req,
 {
     ROS_INFO("Hand: Get act force request recieved");
 
-    getFORCE_ACT(com_port_);
+    if (getFORCE_ACT(com_port_) != TR_OK)
+        return false;
+    std::lock_guard<std::mutex> lock(state_mutex_);
     res.curforce[0] = curforce_[0];
     res.curforce[1] = curforce_[1];
     res.curforce[2] = curforce_[2];
     res.curforce[3] = curforce_[3];
     res.curforce[4] = curforce_[4];
     res.curforce[5] = curforce_[5];
+    return true;
 }
 
 bool
@@ -3200,13 +2895,16 @@ hand_serial::getCURRENTCallback(inspire_hand::get_current::Request &req,
                                 inspire_hand::get_current::Response &res)
 {
     ROS_INFO("Hand: Get current request recieved");
-    getCURRENT(com_port_);
+    if (getCURRENT(com_port_) != TR_OK)
+        return false;
+    std::lock_guard<std::mutex> lock(state_mutex_);
     res.current[0] = current_[0];
     res.current[1] = current_[1];
     res.current[2] = current_[2];
     res.current[3] = current_[3];
     res.current[4] = current_[4];
     res.current[5] = current_[5];
+    return true;
 }
 
 bool
@@ -3215,12 +2913,14 @@ hand_serial::getERRORCallback(inspire_hand::get_error::Request &req,
 {
     ROS_INFO("Hand: Get error request recieved");
     getERROR(com_port_);
+    std::lock_guard<std::mutex> lock(state_mutex_);
     res.errorvalue[0] = errorvalue_[0];
     res.errorvalue[1] = errorvalue_[1];
     res.errorvalue[2] = errorvalue_[2];
     res.errorvalue[3] = errorvalue_[3];
     res.errorvalue[4] = errorvalue_[4];
     res.errorvalue[5] = errorvalue_[5];
+    return true;
 }
 
 bool
@@ -3228,13 +2928,16 @@ hand_serial::getSTATUSCallback(inspire_hand::get_status::Request &req,
                                inspire_hand::get_status::Response &res)
 {
     ROS_INFO("Hand: Get status request recieved");
-    getSTATUS(com_port_);
+    if (getSTATUS(com_port_) != TR_OK)
+        return false;
+    std::lock_guard<std::mutex> lock(state_mutex_);
     res.statusvalue[0] = statusvalue_[0];
     res.statusvalue[1] = statusvalue_[1];
     res.statusvalue[2] = statusvalue_[2];
     res.statusvalue[3] = statusvalue_[3];
     res.statusvalue[4] = statusvalue_[4];
     res.statusvalue[5] = statusvalue_[5];
+    return true;
 }
 
 bool
@@ -3242,13 +2945,16 @@ hand_serial::getTEMPCallback(inspire_hand::get_temp::Request &req,
                              inspire_hand::get_temp::Response &res)
 {
     ROS_INFO("Hand: Get temp request recieved");
-    getTEMP(com_port_);
+    if (getTEMP(com_port_) != TR_OK)
+        return false;
+    std::lock_guard<std::mutex> lock(state_mutex_);
     res.tempvalue[0] = tempvalue_[0];
     res.tempvalue[1] = tempvalue_[1];
     res.tempvalue[2] = tempvalue_[2];
     res.tempvalue[3] = tempvalue_[3];
     res.tempvalue[4] = tempvalue_[4];
     res.tempvalue[5] = tempvalue_[5];
+    return true;
 }
 
 bool
@@ -3256,13 +2962,15 @@ hand_serial::getPOS_SETCallback(inspire_hand::get_pos_set::Request &req,
                                 inspire_hand::get_pos_set::Response &res)
 {
     ROS_INFO("Hand: Get act pos request recieved");
-    getPOS_SET(com_port_);
+    if (getPOS_SET(com_port_) != TR_OK)
+        return false;
     res.setpos[0] = setpos_[0];
     res.setpos[1] = setpos_[1];
     res.setpos[2] = setpos_[2];
     res.setpos[3] = setpos_[3];
     res.setpos[4] = setpos_[4];
     res.setpos[5] = setpos_[5];
+    return true;
 }
 
 bool
@@ -3270,13 +2978,15 @@ hand_serial::getANGLE_SETCallback(inspire_hand::get_angle_set::Request &req,
                                   inspire_hand::get_angle_set::Response &res)
 {
     ROS_INFO("Hand: Get set angle request recieved");
-    getANGLE_SET(com_port_);
+    if (getANGLE_SET(com_port_) != TR_OK)
+        return false;
     res.setangle[0] = setangle_[0];
     res.setangle[1] = setangle_[1];
     res.setangle[2] = setangle_[2];
     res.setangle[3] = setangle_[3];
     res.setangle[4] = setangle_[4];
     res.setangle[5] = setangle_[5];
+    return true;
 }
 
 bool
@@ -3284,15 +2994,540 @@ hand_serial::getFORCE_SETCallback(inspire_hand::get_force_set::Request &req,
                                   inspire_hand::get_force_set::Response &res)
 {
     ROS_INFO("Hand: Get set force request recieved");
-    getFORCE_SET(com_port_);
+    if (getFORCE_SET(com_port_) != TR_OK)
+        return false;
     res.setforce[0] = setforce_[0];
     res.setforce[1] = setforce_[1];
     res.setforce[2] = setforce_[2];
     res.setforce[3] = setforce_[3];
     res.setforce[4] = setforce_[4];
     res.setforce[5] = setforce_[5];
+    return true;
+}
+
+bool
+hand_serial::queryHistoryCallback(inspire_hand::query_history::Request &req,
+                                  inspire_hand::query_history::Response &res)
+{
+    res.success = false;
+    res.samples = 0;
+    uint8_t dof_mask = req.dof_mask ? req.dof_mask : 0x3f;
+    uint8_t channels = req.channels ? req.channels : (1 << state_history::CHANNEL_COUNT) - 1;
+    if (req.window < 0)
+    {
+        res.message = "negative window";
+        return true;
+    }
+
+    int64_t now_ns = ros::Time::now().toNSec();
+    int64_t from_ns = req.window > 0 ? now_ns - int64_t(req.window * 1e9) : INT64_MIN;
+    std::vector<float> scratch;
+
+    //Served from memory under the history lock; the poll loop waits at most this long for its push
+    std::lock_guard<std::mutex> lock(history_mutex_);
+    if (history_.capacity() == 0)
+    {
+        res.message = "no history, set history_size";
+        return true;
+    }
+    state_history::run runs[2];
+    res.samples = history_.window(from_ns, INT64_MAX, runs);
+    if (res.samples > 0)
+    {
+        const int64_t *stamps = history_.stamps();
+        size_t last = runs[1].count > 0 ? runs[1].first + runs[1].count - 1 : runs[0].first + runs[0].count - 1;
+        res.first.fromNSec(stamps[runs[0].first]);
+        res.last.fromNSec(stamps[last]);
+    }
+    scratch.reserve(res.samples);
+
+    for (int c = 0; c < state_history::CHANNEL_COUNT; c++)
+    {
+        if (!(channels & (1 << c)))
+            continue;
+        for (int i = 0; i < state_history::DOF; i++)
+        {
+            if (!(dof_mask & (1 << i)))
+                continue;
+            state_history::window_stats stats;
+            history_.stats(c, i, runs, req.percentile, stats, &scratch);
+            inspire_hand::HistoryAggregate aggregate;
+            aggregate.channel = 1 << c;
+            aggregate.dof = i;
+            aggregate.count = stats.count;
+            aggregate.min = stats.min;
+            aggregate.max = stats.max;
+            aggregate.mean = stats.mean;
+            aggregate.rms = stats.rms;
+            aggregate.percentile = stats.percentile;
+            res.aggregates.push_back(aggregate);
+        }
+    }
+    res.success = true;
+    return true;
+}
+
+
+void
+hand_serial::commandCallback(const inspire_hand::HandCommand::ConstPtr &cmd)
+{
+    postCommand(cmd->source, cmd->priority, cmd->dof_mask, &cmd->angle[0], &cmd->force[0], &cmd->speed[0], cmd->stamp);
+}
+
+void
+hand_serial::shmCommandCallback(const ros::TimerEvent &event)
+{
+    shm_commands_.clear();
+    if (command_shm_.take(shm_commands_) == 0)
+        return;
+    //Same path as the topic: the mailbox keeps the newest target per DOF, expired ones are dropped
+    for (size_t k = 0; k < shm_commands_.size(); ++k)
+    {
+        const shm_command &c = shm_commands_[k];
+        ros::Time stamp;
+        stamp.fromNSec(c.stamp_ns);
+        postCommand(c.source, c.priority, c.dof_mask, c.angle, c.force, c.speed, stamp);
+    }
+}
+
+void
+hand_serial::postCommand(uint8_t source, uint8_t priority, uint8_t dof_mask, const int16_t *angle,
+                         const int16_t *force, const int16_t *speed, const ros::Time &cmd_stamp)
+{
+    //Only the newest target per DOF is kept, the I/O loop writes it on its next cycle
+    ros::Time now = ros::Time::now();
+    ros::Time stamp = cmd_stamp.isZero() ? now : cmd_stamp;
+    uint64_t deadline = command_timeout_ > 0 ? (stamp + ros::Duration(command_timeout_)).toNSec() : 0;
+
+    const int16_t *value[SP_FIELD_COUNT];
+    value[SP_ANGLE] = angle;
+    value[SP_FORCE] = force;
+    value[SP_SPEED] = speed;
+    uint32_t out_of_range = 0;
+    //The topic and the ring take any int16, a DOF with a target the register does not take is dropped
+    //from the command rather than written
+    for (int i = 0; i < 6; i++)
+    {
+        if (!(dof_mask & (1 << i)))
+            continue;
+        for (int f = 0; f < SP_FIELD_COUNT; f++)
+            if (value[f] != NULL && !checkSetpoint(f, value[f][i]))
+            {
+                dof_mask &= ~(1 << i);
+                out_of_range++;
+                break;
+            }
+    }
+    //DOF ownership is leased from arrival time so a source with a stale clock cannot hold a DOF forever
+    uint64_t lease_until = (now + ros::Duration(command_lease_)).toNSec();
+    uint8_t accepted;
+    {
+        std::lock_guard<std::mutex> lock(command_mutex_);
+        commands_out_of_range_ += out_of_range;
+        accepted = commands_.post(source, priority, dof_mask, value, stamp.toNSec(), deadline, now.toNSec(),
+                                  lease_until);
+    }
+    if (accepted != dof_mask)
+        ROS_DEBUG("Hand: source %d lost DOFs 0x%02x to a higher priority source", source, dof_mask & ~accepted);
+    //The command thread writes the targets once this batch of callbacks is done; the motion write
+    //itself wakes an idle poll loop
+}
+
+void
+hand_serial::applyCommands()
+{
+    //Targets stay in the mailbox until bring-up is done, expired ones are dropped then
+    if (!ready_)
+        return;
+
+    setpoint_targets targets;
+    ros::Time now = ros::Time::now();
+    {
+        std::lock_guard<std::mutex> lock(command_mutex_);
+        if (!commands_.take(now.toNSec(), targets))
+            return;
+    }
+
+    //Unset targets are sent as 0xFFFF, the hand keeps them
+    setSETPOINTS(com_port_, targets);
+
+    ros::Time stamp;
+    stamp.fromNSec(targets.oldest_stamp_ns);
+    std::lock_guard<std::mutex> lock(command_mutex_);
+    command_lag_last_ = (ros::Time::now() - stamp).toSec();
+    if (command_lag_last_ > command_lag_max_)
+        command_lag_max_ = command_lag_last_;
+    commands_applied_++;
+}
+
+void
+hand_serial::pollFailed()
+{
+    poll_failures_++;
+    if (poll_failures_ != degraded_after_)
+        return;
+    ROS_ERROR("Hand: no response for %d poll cycles", poll_failures_);
+    {
+        std::lock_guard<std::mutex> lock(health_mutex_);
+        health_.state = inspire_hand::HandHealth::DEGRADED;
+        health_.detail = "hand not responding";
+    }
+    publishHealth();
+}
+
+void
+hand_serial::pollSucceeded()
+{
+    if (poll_failures_ >= degraded_after_)
+    {
+        ROS_INFO("Hand: responding again");
+        {
+            std::lock_guard<std::mutex> lock(health_mutex_);
+            health_.state = inspire_hand::HandHealth::READY;
+            health_.detail = "";
+        }
+        publishHealth();
+    }
+    poll_failures_ = 0;
+}
+
+void
+hand_serial::updatePollRate(bool status_read, bool angle_read, const state_snapshot &state)
+{
+    bool moving = motion_hint_.exchange(false);
+    if (status_read)
+    {
+        //0 releasing, 1 grasping; every other code is a stop (target, force, current, stall, fault)
+        for (int i = 0; i < 6; i++)
+            moving = moving || state.status[i] <= 1;
+    }
+    if (angle_read)
+    {
+        //Catches motion the STATUS read of this cycle did not look at
+        for (int i = 0; i < 6; i++)
+        {
+            if (last_angle_valid_ && fabs(state.angle[i] - last_angle_[i]) >= motion_delta_)
+                moving = true;
+            last_angle_[i] = state.angle[i];
+        }
+        last_angle_valid_ = true;
+    }
+
+    ros::WallTime now = ros::WallTime::now();
+    if (moving)
+        last_motion_ = now;
+    setPollActive((now - last_motion_).toSec() < idle_after_);
+
+    //Cycles a fixed poll_rate loop would have run in this one's place
+    if (!poll_active_)
+        poll_cycles_saved_ += poll_rate_ / idle_poll_rate_ - 1.0;
+}
+
+uint8_t
+hand_serial::safetyReads()
+{
+    uint8_t read = 0;
+    if (safety_rate_ <= 0)
+        return read;
+    ros::WallTime now = ros::WallTime::now();
+    double period = 1.0 / safety_rate_;
+    if ((now - last_error_read_).toSec() >= period)
+    {
+        last_error_read_ = now;
+        if (getERROR(com_port_) != 0xff)
+            read |= inspire_hand::HandState::ERROR;
+    }
+    if ((now - last_temp_read_).toSec() >= period)
+    {
+        last_temp_read_ = now;
+        if (getTEMP(com_port_) == TR_OK)
+            read |= inspire_hand::HandState::TEMP;
+    }
+    return read;
+}
+
+uint8_t
+hand_serial::thermalUpdate(uint8_t safety_read)
+{
+    if (!thermal_enabled_ || !(safety_read & inspire_hand::HandState::TEMP))
+        return 0;
+    ros::WallTime now = ros::WallTime::now();
+    double dt = last_thermal_.toSec() > 0 ? (now - last_thermal_).toSec() : 0;
+    if (getCURRENT(com_port_) != TR_OK)
+        return 0;
+    last_thermal_ = now;
+    state_snapshot state;
+    snapshotState(state);
+
+    uint8_t changed;
+    inspire_hand::HandThermalPtr msg(new inspire_hand::HandThermal);
+    {
+        std::lock_guard<std::mutex> lock(thermal_mutex_);
+        changed = thermal_.update(dt, state.current, state.temp);
+        msg->throttled = thermal_.throttled();
+        for (int i = 0; i < 6; i++)
+        {
+            msg->temperature[i] = thermal_.temperature(i);
+            msg->time_to_limit[i] = thermal_.timeToLimit(i);
+            msg->speed_scale[i] = thermal_.scale(i);
+        }
+    }
+    if (changed)
+    {
+        ROS_INFO("Hand: thermal throttle %.2f %.2f %.2f %.2f %.2f %.2f",
+                 msg->speed_scale[0], msg->speed_scale[1], msg->speed_scale[2],
+                 msg->speed_scale[3], msg->speed_scale[4], msg->speed_scale[5]);
+        //Nothing requested, scaleSpeeds fills in the rescaled speeds
+        setpoint_targets none;
+        none.clear();
+        setSETPOINTS(com_port_, none);
+    }
+    msg->stamp = ros::Time::now();
+    thermal_pub.publish(msg);
+    return inspire_hand::HandState::CURRENT;
+}
+
+void
+hand_serial::scaleSpeeds(int *speeds)
+{
+    std::lock_guard<std::mutex> lock(thermal_mutex_);
+    for (int i = 0; i < 6; i++)
+    {
+        if (speeds[i] >= 0)
+            speed_request_[i] = speeds[i];
+        if (!thermal_enabled_)
+            continue;
+        //The hand's own speed is unknown until one is requested, throttle from full speed then
+        if (speed_request_[i] < 0 && thermal_.scale(i) < 1)
+            speed_request_[i] = 1000;
+        if (speed_request_[i] >= 0)
+            speeds[i] = int(speed_request_[i] * thermal_.scale(i) + 0.5);
+    }
+}
+
+void
+hand_serial::setPollActive(bool active)
+{
+    if (active == poll_active_ || idle_poll_rate_ >= poll_rate_)
+        return;
+    poll_active_ = active;
+    double rate = active ? poll_rate_ : idle_poll_rate_;
+    poll_timer_.setPeriod(ros::Duration(1.0 / rate));
+    poll_rate_changes_++;
+    ROS_INFO("Hand: %s, polling at %.1f Hz", active ? "moving" : "idle", rate);
+}
+
+void
+hand_serial::statsTimerCallback(const ros::TimerEvent &event)
+{
+    inspire_hand::CommandStatsPtr stats(new inspire_hand::CommandStats);
+    stats->stamp = ros::Time::now();
+    {
+        std::lock_guard<std::mutex> lock(command_mutex_);
+        stats->received = commands_.received();
+        stats->applied = commands_applied_;
+        stats->coalesced = commands_.coalesced();
+        stats->expired = commands_.expired();
+        stats->rejected = commands_.rejected();
+        stats->out_of_range = commands_out_of_range_;
+        stats->lag_last = command_lag_last_;
+        stats->lag_max = command_lag_max_;
+        command_lag_max_ = 0;
+    }
+    {
+        std::lock_guard<std::mutex> lock(setpoint_mutex_);
+        stats->suppressed = setpoints_suppressed_;
+        stats->setpoint_bytes = setpoint_bytes_;
+    }
+    stats->shm_taken = command_shm_.taken();
+    stats->shm_lost = command_shm_.lost();
+    command_stats_pub.publish(stats);
+
+    inspire_hand::BusStatsPtr bus(new inspire_hand::BusStats);
+    bus->stamp = stats->stamp;
+    {
+        std::lock_guard<std::mutex> lock(bus_mutex_);
+        bus->transactions = bus_stats_.transactions;
+        bus->retries = bus_stats_.retries;
+        bus->timeouts = bus_stats_.timeouts;
+        bus->corrupt = bus_stats_.corrupt;
+        bus->short_frames = bus_stats_.short_frames;
+        bus->unmatched = bus_stats_.unmatched;
+        bus->frames = parser_.frames();
+        bus->checksum_errors = parser_.checksumErrors();
+        bus->resyncs = parser_.resyncs();
+        bus->skipped_bytes = parser_.skippedBytes();
+        bus->busy_time = bus_stats_.busy_time;
+        for (std::map<uint16_t, uint32_t>::const_iterator it = bus_stats_.register_errors.begin();
+             it != bus_stats_.register_errors.end(); ++it)
+        {
+            bus->error_registers.push_back(it->first);
+            bus->error_counts.push_back(it->second);
+        }
+    }
+    bus->poll_rate = poll_active_ ? poll_rate_ : idle_poll_rate_;
+    bus->poll_cycles = poll_count_;
+    bus->poll_cycles_saved = uint32_t(poll_cycles_saved_);
+    bus->poll_rate_changes = poll_rate_changes_;
+    for (int c = 0; c < BUS_CLASS_COUNT; c++)
+    {
+        latency_histogram delay;
+        uint32_t promoted;
+        bus_scheduler_.stats(c, delay, promoted);
+        bus->grants[c] = delay.count();
+        bus->promoted[c] = promoted;
+        bus->queue_delay_mean[c] = delay.mean() * 1e-6;
+        bus->queue_delay_p99[c] = delay.percentile(99) * 1e-6;
+        bus->queue_delay_max[c] = delay.max() * 1e-6;
+    }
+    bus_stats_pub.publish(bus);
 }
 
+void
+hand_serial::pollTimerCallback(const ros::TimerEvent &event)
+{
+    if (!ready_)
+        return;
+
+    //A silent hand costs this cycle its deadline and retries, not the node
+    if (getFORCE_ACT(com_port_) != TR_OK)
+    {
+        pollFailed();
+        return;
+    }
+    pollSucceeded();
+    ros::Time stamp = ros::Time::now();
+    //Service calls refresh the same cache from the spinner, everything below works on copies
+    state_snapshot cached;
+    snapshotState(cached);
+    logger_.log(LOG_FORCE_ACT, cached.force, stamp.toNSec());
+
+    //Angles cost another transaction, only read them when someone needs them
+    bool want_angle = dataset_.isOpen() || shm_.isOpen() || history_.capacity() > 0 || state_pub.getNumSubscribers() > 0;
+    if (want_angle)
+    {
+        if (getANGLE_ACT(com_port_) != TR_OK)
+            return;
+        snapshotState(cached);
+        logger_.log(LOG_ANGLE_ACT, cached.angle, stamp.toNSec());
+    }
+
+    //STATUS is read every cycle while idle, it is what wakes the loop up when something
+    //else moves the hand; while moving every status_divider cycles is enough
+    bool status_read = false;
+    if (!poll_active_ || poll_count_ % status_divider_ == 0)
+        status_read = getSTATUS(com_port_) == TR_OK;
+    snapshotState(cached);
+    updatePollRate(status_read, want_angle, cached);
+    uint8_t safety_read = safetyReads();
+    safety_read |= thermalUpdate(safety_read);
+    //Dataset rows also carry CURRENT and TEMP, read with the rest of the cycle rather than after
+    //publishing; temperature changes slowly and is refreshed every dataset_temp_divider cycles,
+    //older values are held. Reads the safety and thermal paths already made are not repeated
+    if (dataset_.isOpen())
+    {
+        if (!(safety_read & inspire_hand::HandState::CURRENT) && getCURRENT(com_port_) == TR_OK)
+            safety_read |= inspire_hand::HandState::CURRENT;
+        if (!(safety_read & inspire_hand::HandState::TEMP) && poll_count_ % dataset_temp_divider_ == 0 &&
+            getTEMP(com_port_) == TR_OK)
+            safety_read |= inspire_hand::HandState::TEMP;
+    }
+    //The row is stamped once its last register is in
+    ros::Time row_stamp = ros::Time::now();
+    if (safety_read)
+        snapshotState(cached);
+
+    uint8_t valid = inspire_hand::HandState::FORCE | safety_read;
+    if (want_angle)
+        valid |= inspire_hand::HandState::ANGLE;
+    if (status_read)
+        valid |= inspire_hand::HandState::STATUS;
+
+    if (shm_.isOpen())
+    {
+        //Same sample as the state topic, without serialization or a trip through the ROS queues
+        shm_state_sample sample;
+        memset(&sample, 0, sizeof(sample));
+        sample.stamp_ns = stamp.toNSec();
+        sample.cycle = poll_count_;
+        sample.hand_id = hand_id_;
+        sample.valid = valid;
+        sample.dof_mask = 0x3f;
+        for (int i = 0; i < 6; i++)
+        {
+            sample.angle[i] = cached.angle[i];
+            sample.force[i] = cached.force[i];
+            sample.current[i] = cached.current[i];
+            sample.status[i] = cached.status[i];
+            sample.error[i] = cached.error[i];
+            sample.temp[i] = cached.temp[i];
+        }
+        sample.publish_ns = ros::WallTime::now().toNSec();
+        shm_.publish(sample);
+    }
+
+    if (state_pub.getNumSubscribers() > 0)
+    {
+        //Published by pointer, nodelets in the same manager get it without a copy
+        inspire_hand::HandStatePtr state(new inspire_hand::HandState);
+        state->stamp = stamp;
+        state->hand_id = hand_id_;
+        state->valid = valid;
+        state->dof_mask = 0x3f;
+        for (int i = 0; i < 6; i++)
+        {
+            state->angle[i] = cached.angle[i];
+            state->force[i] = cached.force[i];
+            state->current[i] = cached.current[i];
+            state->status[i] = cached.status[i];
+            state->error[i] = cached.error[i];
+            state->temp[i] = cached.temp[i];
+        }
+        state_pub.publish(state);
+    }
+
+    if (dataset_.isOpen())
+    {
+        float row[DS_CHANNEL_COUNT][DS_DOF];
+        {
+            std::lock_guard<std::mutex> lock(setpoint_mutex_);
+            for (int i = 0; i < DS_DOF; i++)
+                row[DS_ANGLE_CMD][i] = cmdangle_[i];
+        }
+        for (int i = 0; i < DS_DOF; i++)
+        {
+            row[DS_ANGLE_ACT][i] = cached.angle[i];
+            row[DS_FORCE_ACT][i] = cached.force[i];
+            row[DS_CURRENT][i] = cached.current[i];
+            row[DS_TEMP][i] = cached.temp[i];
+        }
+        dataset_.append(row_stamp.toNSec(), row);
+    }
+
+    if (history_.capacity() > 0)
+    {
+        std::lock_guard<std::mutex> lock(history_mutex_);
+        history_.push(stamp.toNSec(), valid, cached.angle, cached.force, cached.current, cached.status, cached.error,
+                      cached.temp);
+    }
+    poll_count_++;
+
+    //Only edges are published, so a finger resting on an object costs nothing
+    uint8_t changed = contact_.update(cached.force);
+    for (int i = 0; i < contact_detector::DOF; i++)
+    {
+        if (!(changed & (1 << i)))
+            continue;
+        inspire_hand::ContactEventPtr event_msg(new inspire_hand::ContactEvent);
+        event_msg->header.stamp = stamp;
+        event_msg->dof = i;
+        event_msg->contact = contact_.inContact(i);
+        event_msg->force = cached.force[i];
+        contact_pub.publish(event_msg);
+        if (test_flags == 1)
+            ROS_INFO_STREAM("Hand: finger " << i << (event_msg->contact ? " contact " : " release ") << cached.force[i]);
+    }
+}
 
 //bool
 //	hand_serial::setParamCallback(inspire_hand::set_param::Request &req,
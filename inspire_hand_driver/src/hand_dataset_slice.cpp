@@ -0,0 +1,57 @@
+#include <dataset_exporter.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+//Print the chunk index of a dataset file, or a time window of it as CSV
+//usage: hand_dataset_slice <file.ihds> [t0 t1]   (seconds since epoch)
+int
+main(int argc, char *argv[])
+{
+    if (argc != 2 && argc != 4)
+    {
+        fprintf(stderr, "usage: %s <file.ihds> [t0 t1]\n", argv[0]);
+        return(EXIT_FAILURE);
+    }
+
+    inspire_hand::dataset_reader reader;
+    if (!reader.open(argv[1]))
+    {
+        fprintf(stderr, "%s: not a hand dataset\n", argv[1]);
+        return(EXIT_FAILURE);
+    }
+
+    if (argc == 2)
+    {
+        printf("hand_id %u, %zu chunks, %llu rows\n", reader.header().hand_id, reader.chunkCount(),
+               (unsigned long long)reader.rows());
+        for (size_t i = 0; i < reader.chunkCount(); i++)
+        {
+            const inspire_hand::dataset_index_entry &e = reader.chunkInfo(i);
+            printf("chunk %zu: offset %llu rows %u t [%.6f %.6f]\n", i, (unsigned long long)e.offset, e.rows,
+                   e.t_first * 1e-9, e.t_last * 1e-9);
+        }
+        return(EXIT_SUCCESS);
+    }
+
+    uint64_t t0 = (uint64_t)(atof(argv[2]) * 1e9);
+    uint64_t t1 = (uint64_t)(atof(argv[3]) * 1e9);
+    inspire_hand::dataset_slice slice;
+    size_t rows = reader.slice(t0, t1, slice);
+
+    printf("stamp");
+    for (int c = 0; c < inspire_hand::DS_CHANNEL_COUNT; c++)
+        for (int d = 0; d < inspire_hand::DS_DOF; d++)
+            printf(",%s%d", inspire_hand::dataset_channel_name(c), d);
+    printf("\n");
+    for (size_t r = 0; r < rows; r++)
+    {
+        printf("%llu.%09llu", (unsigned long long)(slice.stamp[r] / 1000000000ull),
+               (unsigned long long)(slice.stamp[r] % 1000000000ull));
+        for (int c = 0; c < inspire_hand::DS_CHANNEL_COUNT; c++)
+            for (int d = 0; d < inspire_hand::DS_DOF; d++)
+                printf(",%d", slice.column[c][d][r]);
+        printf("\n");
+    }
+    return(EXIT_SUCCESS);
+}
@@ -0,0 +1,46 @@
+#include <state_logger.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+//Convert a binary state log written by state_logger to CSV
+//usage: hand_log_to_csv <log.bin> [out.csv]
+int
+main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <log.bin> [out.csv]\n", argv[0]);
+        return(EXIT_FAILURE);
+    }
+
+    inspire_hand::log_file_header header;
+    std::vector<inspire_hand::log_record> records;
+    if (!inspire_hand::state_logger::readFile(argv[1], header, records))
+    {
+        fprintf(stderr, "%s: not a hand state log\n", argv[1]);
+        return(EXIT_FAILURE);
+    }
+
+    FILE *out = argc > 2 ? fopen(argv[2], "w") : stdout;
+    if (out == NULL)
+    {
+        fprintf(stderr, "%s: cannot open\n", argv[2]);
+        return(EXIT_FAILURE);
+    }
+
+    fprintf(out, "stamp,hand_id,channel,v0,v1,v2,v3,v4,v5\n");
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        const inspire_hand::log_record &r = records[i];
+        fprintf(out, "%llu.%09llu,%d,%s,%d,%d,%d,%d,%d,%d\n",
+                (unsigned long long)(r.stamp_ns / 1000000000ull),
+                (unsigned long long)(r.stamp_ns % 1000000000ull),
+                r.hand_id, inspire_hand::log_channel_name(r.channel),
+                r.value[0], r.value[1], r.value[2], r.value[3], r.value[4], r.value[5]);
+    }
+
+    if (out != stdout)
+        fclose(out);
+    return(EXIT_SUCCESS);
+}
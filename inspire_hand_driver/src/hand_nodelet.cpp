@@ -0,0 +1,36 @@
+#include <hand_control.h>
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <boost/scoped_ptr.hpp>
+
+namespace inspire_hand
+{
+
+//hand_serial packaged as a nodelet. Nodelets loaded into the same manager
+//exchange HandState/HandCommand/ContactEvent as shared pointers, without
+//serialization or a loopback socket.
+class hand_nodelet : public nodelet::Nodelet
+{
+public:
+
+    hand_nodelet() {}
+
+private:
+
+    virtual void onInit()
+    {
+        //Same relative names as the standalone node, so launch params and
+        //service names do not change. getNodeHandle() keeps callbacks of
+        //this nodelet serialized like ros::spin() in the standalone node.
+        nh_ = getNodeHandle();
+        hand_.reset(new hand_serial(&nh_));
+        hand_->advertise(&nh_);
+    }
+
+    ros::NodeHandle nh_;
+    boost::scoped_ptr<hand_serial> hand_;
+};
+}
+
+PLUGINLIB_EXPORT_CLASS(inspire_hand::hand_nodelet, nodelet::Nodelet)
@@ -0,0 +1,51 @@
+#include <state_shm.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+//Print the hand state the driver exports to shared memory, with the age of each sample
+//usage: hand_shm_echo <name> [count]
+int
+main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <name> [count]\n", argv[0]);
+        return(EXIT_FAILURE);
+    }
+    long count = argc > 2 ? atol(argv[2]) : -1;
+
+    inspire_hand::state_shm_reader reader;
+    if (!reader.open(argv[1]))
+    {
+        fprintf(stderr, "%s: no hand state segment\n", argv[1]);
+        return(EXIT_FAILURE);
+    }
+
+    uint32_t last = 0;
+    while (count != 0 && reader.writerAlive())
+    {
+        //Checking the sequence costs one load, only copy when there is something new
+        if (reader.sequence() == last)
+        {
+            usleep(100);
+            continue;
+        }
+        inspire_hand::shm_state_sample s;
+        if (!reader.read(s, &last))
+            continue;
+
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        uint64_t now = uint64_t(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+        printf("cycle %u hand %d age %.1f us angle %d %d %d %d %d %d force %d %d %d %d %d %d\n",
+               s.cycle, s.hand_id, (now - s.publish_ns) * 1e-3,
+               s.angle[0], s.angle[1], s.angle[2], s.angle[3], s.angle[4], s.angle[5],
+               s.force[0], s.force[1], s.force[2], s.force[3], s.force[4], s.force[5]);
+        if (count > 0)
+            count--;
+    }
+    return(EXIT_SUCCESS);
+}
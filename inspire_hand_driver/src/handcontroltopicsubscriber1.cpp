@@ -1,30 +1,18 @@
 #include <ros/ros.h>
 
-#include <hand_control.h>
-
 #include <stdio.h>
 #include <stdlib.h>
 #include <vector>
 #include <iostream>
 
 
-#include <std_msgs/String.h>
-#include "std_msgs/MultiArrayLayout.h"
-#include "std_msgs/MultiArrayDimension.h"
-
-#include "std_msgs/Int32MultiArray.h"
+#include <inspire_hand/HandCommand.h>
 
 using namespace std;
 
 
 
 
-int hand_id_;
-std::string port_name_;
-int baudrate_;
-int test_flags;
-serial::Serial *com_port_;
-uint8_t hand_state_;
 float setangle_[6];
 float setforce_[6];
 
@@ -35,17 +23,9 @@ int main(int argc, char *argv[])
     ros::NodeHandle nh;
 
 
-    //Read launch file params
-    nh.getParam("inspire_hand/hand_id", hand_id_);
-    nh.getParam("inspire_hand/portname", port_name_);
-    nh.getParam("inspire_hand/baudrate", baudrate_);
-    nh.getParam("inspire_hand/test_flags", test_flags);
-    //Initialize and open serial port
-    com_port_ = new serial::Serial(port_name_, (uint32_t)baudrate_, serial::Timeout::simpleTimeout(100));
-
     //topic
 
-    ros::Publisher  pub = nh.advertise<std_msgs::Int32MultiArray>("chatter1", 1000);
+    ros::Publisher  pub = nh.advertise<inspire_hand::HandCommand>("chatter1", 1000);
 
     ros::Rate loop_rate(10);
     setangle_[0] = 1000;
@@ -62,27 +42,19 @@ int main(int argc, char *argv[])
     setforce_[4] = 200;
     setforce_[5] = 200;
 
+    inspire_hand::HandCommand cmd;
+    cmd.dof_mask = 0x3f;
+    for (int i = 0; i <6; i++)
+    {
+        cmd.angle[i] = setangle_[i];
+        cmd.force[i] = setforce_[i];
+        cmd.speed[i] = -1;
+    }
     while (ros::ok())
     {
-        std_msgs::Int32MultiArray array;
-        //Clear array
-        array.data.clear();
-
-
-        for (int i = 0; i <6; i++)
-        {
-            //assign array a random number between 0 and 255.
-            array.data.push_back(setangle_[i]);
-
-        }
-        for (int i = 0; i <6; i++)
-        {
-            //assign array a random number between 0 and 255.
-            array.data.push_back(setforce_[i]);
-
-        }
-        //Publish array
-        pub.publish(array);
+        cmd.stamp = ros::Time::now();
+        //Publish command
+        pub.publish(cmd);
 
 
         loop_rate.sleep();
@@ -0,0 +1,85 @@
+#include <latency_histogram.h>
+
+namespace inspire_hand
+{
+
+latency_histogram::latency_histogram()
+{
+    reset();
+}
+
+int
+latency_histogram::bucketOf(uint64_t value)
+{
+    const uint64_t SUB = 1 << SUB_BITS;
+    const uint64_t HALF = SUB >> 1;
+    if (value < SUB)
+        return int(value);
+    if (value >> MAX_BITS)
+        value = (uint64_t(1) << MAX_BITS) - 1;
+    //Shift so the value keeps SUB_BITS significant bits, the top one always set
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - (SUB_BITS - 1);
+    return int(SUB + (shift - 1) * HALF + ((value >> shift) - HALF));
+}
+
+uint64_t
+latency_histogram::bucketHigh(int bucket)
+{
+    const int SUB = 1 << SUB_BITS;
+    const int HALF = SUB >> 1;
+    if (bucket < SUB)
+        return bucket;
+    int k = bucket - SUB;
+    int shift = k / HALF + 1;
+    uint64_t mantissa = k % HALF + HALF;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+void
+latency_histogram::record(uint64_t value)
+{
+    counts_[bucketOf(value)]++;
+    if (count_ == 0 || value < min_)
+        min_ = value;
+    if (value > max_)
+        max_ = value;
+    sum_ += value;
+    count_++;
+}
+
+uint64_t
+latency_histogram::percentile(double p) const
+{
+    if (count_ == 0)
+        return 0;
+    uint64_t rank = uint64_t(p / 100.0 * count_ + 0.5);
+    if (rank < 1)
+        rank = 1;
+    if (rank > count_)
+        rank = count_;
+    uint64_t seen = 0;
+    for (int b = 0; b < BUCKETS; b++)
+    {
+        seen += counts_[b];
+        if (seen >= rank)
+        {
+            //The bucket bound can overshoot the largest value actually seen
+            uint64_t high = bucketHigh(b);
+            return high < max_ ? high : max_;
+        }
+    }
+    return max_;
+}
+
+void
+latency_histogram::reset()
+{
+    for (int b = 0; b < BUCKETS; b++)
+        counts_[b] = 0;
+    count_ = 0;
+    min_ = 0;
+    max_ = 0;
+    sum_ = 0;
+}
+}
@@ -0,0 +1,176 @@
+#include <state_history.h>
+
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+
+namespace inspire_hand
+{
+
+const size_t state_history::ALIGNMENT;
+const size_t state_history::MIN_CAPACITY;
+
+state_history::state_history():
+    block_(NULL),
+    capacity_(0),
+    pushed_(0),
+    stamps_(NULL),
+    valid_(NULL),
+    data_(NULL)
+{
+}
+
+state_history::~state_history()
+{
+    free(block_);
+}
+
+bool
+state_history::allocate(size_t capacity)
+{
+    free(block_);
+    block_ = NULL;
+    capacity_ = 0;
+    pushed_ = 0;
+    stamps_ = NULL;
+    valid_ = NULL;
+    data_ = NULL;
+    if (capacity == 0)
+        return true;
+
+    //A power of two turns the ring index into a mask; at MIN_CAPACITY and up
+    //every float array is a whole number of cache lines, so all stay aligned
+    size_t cap = MIN_CAPACITY;
+    while (cap < capacity)
+        cap <<= 1;
+
+    //Layout: float arrays, then stamps, then valid bits
+    size_t data_bytes = sizeof(float) * CHANNEL_COUNT * DOF * cap;
+    size_t stamp_bytes = sizeof(int64_t) * cap;
+    if (posix_memalign(&block_, ALIGNMENT, data_bytes + stamp_bytes + cap) != 0)
+    {
+        block_ = NULL;
+        return false;
+    }
+    data_ = static_cast<float *>(block_);
+    stamps_ = reinterpret_cast<int64_t *>(static_cast<char *>(block_) + data_bytes);
+    valid_ = reinterpret_cast<uint8_t *>(static_cast<char *>(block_) + data_bytes + stamp_bytes);
+    capacity_ = cap;
+    return true;
+}
+
+void
+state_history::push(int64_t stamp_ns, uint8_t valid, const float *angle, const float *force, const float *current,
+                    const float *status, const float *error, const float *temp)
+{
+    if (capacity_ == 0)
+        return;
+    size_t s = size_t(pushed_) & (capacity_ - 1);
+    const float *channels[CHANNEL_COUNT] = { angle, force, current, status, error, temp };
+    for (int c = 0; c < CHANNEL_COUNT; c++)
+    {
+        float *column = data_ + size_t(c) * DOF * capacity_;
+        for (int i = 0; i < DOF; i++)
+            column[i * capacity_ + s] = channels[c][i];
+    }
+    stamps_[s] = stamp_ns;
+    valid_[s] = valid;
+    pushed_++;
+}
+
+size_t
+state_history::lowerBound(int64_t stamp_ns) const
+{
+    size_t lo = 0;
+    size_t hi = size();
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (stamps_[ordered(mid)] < stamp_ns)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+size_t
+state_history::window(int64_t from_ns, int64_t to_ns, run runs[2]) const
+{
+    runs[0].first = runs[1].first = 0;
+    runs[0].count = runs[1].count = 0;
+    if (capacity_ == 0 || from_ns > to_ns)
+        return 0;
+
+    size_t begin = lowerBound(from_ns);
+    size_t end = to_ns == INT64_MAX ? size() : lowerBound(to_ns + 1);
+    if (begin >= end)
+        return 0;
+
+    //Split where the ring wraps
+    size_t first = ordered(begin);
+    size_t n = end - begin;
+    size_t head = capacity_ - first;
+    runs[0].first = first;
+    runs[0].count = n < head ? n : head;
+    if (n > head)
+        runs[1].count = n - head;
+    return n;
+}
+
+void
+state_history::stats(int channel, int dof, const run runs[2], double percentile, window_stats &out,
+                     std::vector<float> *scratch) const
+{
+    out.count = 0;
+    out.min = out.max = out.mean = out.rms = out.percentile = 0;
+    if (capacity_ == 0 || channel < 0 || channel >= CHANNEL_COUNT || dof < 0 || dof >= DOF)
+        return;
+    if (scratch)
+        scratch->clear();
+
+    const float *column = data(channel, dof);
+    const uint8_t bit = 1 << channel;
+    float lo = 0;
+    float hi = 0;
+    double sum = 0;
+    double sum_sq = 0;
+    uint32_t n = 0;
+    for (int r = 0; r < 2; r++)
+    {
+        size_t end = runs[r].first + runs[r].count;
+        for (size_t s = runs[r].first; s < end; s++)
+        {
+            //Channels not read in a cycle hold the previous value, they would weigh it twice
+            if (!(valid_[s] & bit))
+                continue;
+            float v = column[s];
+            if (n == 0 || v < lo)
+                lo = v;
+            if (n == 0 || v > hi)
+                hi = v;
+            sum += v;
+            sum_sq += double(v) * v;
+            n++;
+            if (scratch)
+                scratch->push_back(v);
+        }
+    }
+    if (n == 0)
+        return;
+
+    out.count = n;
+    out.min = lo;
+    out.max = hi;
+    out.mean = sum / n;
+    out.rms = sqrt(sum_sq / n);
+    if (scratch)
+    {
+        double p = percentile < 0 ? 0 : (percentile > 100 ? 100 : percentile);
+        size_t rank = size_t(ceil(p / 100.0 * n));
+        size_t k = rank > 0 ? rank - 1 : 0;
+        std::nth_element(scratch->begin(), scratch->begin() + k, scratch->end());
+        out.percentile = (*scratch)[k];
+    }
+}
+}
@@ -0,0 +1,172 @@
+#include <state_logger.h>
+
+#include <string.h>
+#include <time.h>
+#include <chrono>
+
+namespace inspire_hand
+{
+
+//Writer wakes up this often when the queue is empty
+static const int WRITER_IDLE_MS = 5;
+//Records per fwrite
+static const size_t WRITE_BATCH = 512;
+
+const char *
+log_channel_name(uint8_t channel)
+{
+    static const char *names[LOG_CHANNEL_COUNT] = {
+        "angle_act", "force_act", "current", "error", "status",
+        "temp", "angle_set", "force_set", "pos_act"
+    };
+    return channel < LOG_CHANNEL_COUNT ? names[channel] : "unknown";
+}
+
+state_logger::state_logger():
+    mask_(0),
+    head_(0),
+    tail_(0),
+    dropped_(0),
+    written_(0),
+    running_(false),
+    hand_id_(0),
+    file_(NULL)
+{
+}
+
+state_logger::~state_logger()
+{
+    close();
+}
+
+bool
+state_logger::open(const std::string &path, int hand_id, size_t capacity)
+{
+    close();
+
+    size_t size = 1;
+    while (size < capacity)
+        size <<= 1;
+    ring_.assign(size, log_record());
+    mask_ = size - 1;
+    head_.store(0);
+    tail_.store(0);
+    dropped_.store(0);
+    written_.store(0);
+    hand_id_ = (uint8_t)hand_id;
+
+    file_ = fopen(path.c_str(), "wb");
+    if (file_ == NULL)
+        return false;
+
+    log_file_header header;
+    memcpy(header.magic, "IHLG", 4);
+    header.version = VERSION;
+    header.record_size = sizeof(log_record);
+    header.hand_id = hand_id;
+    fwrite(&header, sizeof(header), 1, file_);
+
+    running_.store(true);
+    writer_ = std::thread(&state_logger::writerLoop, this);
+    return true;
+}
+
+void
+state_logger::close()
+{
+    if (file_ == NULL)
+        return;
+    running_.store(false);
+    if (writer_.joinable())
+        writer_.join();
+    fclose(file_);
+    file_ = NULL;
+}
+
+bool
+state_logger::log(uint8_t channel, const float *value, uint64_t stamp_ns)
+{
+    if (file_ == NULL)
+        return false;
+
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) > mask_)
+    {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    log_record &rec = ring_[head & mask_];
+    rec.stamp_ns = stamp_ns ? stamp_ns : now();
+    rec.channel = channel;
+    rec.hand_id = hand_id_;
+    for (int i = 0; i < 6; i++)
+        rec.value[i] = (int16_t)value[i];
+
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+void
+state_logger::writerLoop()
+{
+    std::vector<log_record> batch;
+    batch.reserve(WRITE_BATCH);
+
+    while (true)
+    {
+        //Read running_ before draining so nothing queued before close() is lost
+        bool running = running_.load();
+
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t head = head_.load(std::memory_order_acquire);
+        while (tail != head)
+        {
+            batch.clear();
+            while (tail != head && batch.size() < WRITE_BATCH)
+            {
+                batch.push_back(ring_[tail & mask_]);
+                tail++;
+            }
+            tail_.store(tail, std::memory_order_release);
+            fwrite(&batch[0], sizeof(log_record), batch.size(), file_);
+            written_.fetch_add(batch.size(), std::memory_order_relaxed);
+        }
+
+        if (!running)
+            break;
+        fflush(file_);
+        std::this_thread::sleep_for(std::chrono::milliseconds(WRITER_IDLE_MS));
+    }
+    fflush(file_);
+}
+
+uint64_t
+state_logger::now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+bool
+state_logger::readFile(const std::string &path, log_file_header &header, std::vector<log_record> &records)
+{
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == NULL)
+        return false;
+
+    bool ok = fread(&header, sizeof(header), 1, f) == 1
+            && memcmp(header.magic, "IHLG", 4) == 0
+            && header.record_size == sizeof(log_record);
+    if (ok)
+    {
+        log_record rec;
+        records.clear();
+        while (fread(&rec, sizeof(rec), 1, f) == 1)
+            records.push_back(rec);
+    }
+    fclose(f);
+    return ok;
+}
+}
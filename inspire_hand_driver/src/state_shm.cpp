@@ -0,0 +1,163 @@
+#include <state_shm.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+namespace inspire_hand
+{
+
+//Readers in other processes see the counters as plain words
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && sizeof(std::atomic<uint32_t>) == 4,
+              "shared counters must be lock free 32 bit words");
+
+state_shm_writer::state_shm_writer():
+    segment_(NULL)
+{
+}
+
+state_shm_writer::~state_shm_writer()
+{
+    close();
+}
+
+bool
+state_shm_writer::open(const std::string &name)
+{
+    close();
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0)
+        return false;
+    if (ftruncate(fd, sizeof(shm_state_segment)) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    void *p = mmap(NULL, sizeof(shm_state_segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+        return false;
+
+    //A segment left behind by a previous run is taken over; the sequence keeps counting so
+    //readers still mapped to it see the new samples as news
+    segment_ = static_cast<shm_state_segment *>(p);
+    memcpy(segment_->magic, "IHSM", 4);
+    segment_->version = VERSION;
+    segment_->sample_size = sizeof(shm_state_sample);
+    segment_->seq.store(segment_->seq.load(std::memory_order_relaxed) & ~1u, std::memory_order_relaxed);
+    segment_->alive.store(1, std::memory_order_release);
+    name_ = name;
+    return true;
+}
+
+void
+state_shm_writer::close()
+{
+    if (segment_ == NULL)
+        return;
+    segment_->alive.store(0, std::memory_order_release);
+    munmap(segment_, sizeof(shm_state_segment));
+    shm_unlink(name_.c_str());
+    segment_ = NULL;
+}
+
+void
+state_shm_writer::publish(const shm_state_sample &sample)
+{
+    if (segment_ == NULL)
+        return;
+    uint32_t seq = segment_->seq.load(std::memory_order_relaxed);
+    segment_->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&segment_->sample, &sample, sizeof(sample));
+    segment_->seq.store(seq + 2, std::memory_order_release);
+}
+
+state_shm_reader::state_shm_reader():
+    segment_(NULL)
+{
+}
+
+state_shm_reader::~state_shm_reader()
+{
+    close();
+}
+
+bool
+state_shm_reader::open(const std::string &name)
+{
+    close();
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(shm_state_segment))
+    {
+        ::close(fd);
+        return false;
+    }
+    void *p = mmap(NULL, sizeof(shm_state_segment), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+        return false;
+
+    const shm_state_segment *segment = static_cast<const shm_state_segment *>(p);
+    if (memcmp(segment->magic, "IHSM", 4) != 0 || segment->version != state_shm_writer::VERSION
+        || segment->sample_size != sizeof(shm_state_sample))
+    {
+        munmap(p, sizeof(shm_state_segment));
+        return false;
+    }
+    segment_ = segment;
+    return true;
+}
+
+void
+state_shm_reader::close()
+{
+    if (segment_ == NULL)
+        return;
+    munmap(const_cast<shm_state_segment *>(segment_), sizeof(shm_state_segment));
+    segment_ = NULL;
+}
+
+bool
+state_shm_reader::read(shm_state_sample &sample, uint32_t *seq, int max_tries) const
+{
+    if (segment_ == NULL)
+        return false;
+    for (int i = 0; i < max_tries; i++)
+    {
+        uint32_t before = segment_->seq.load(std::memory_order_acquire);
+        if (before == 0)
+            return false;
+        if (before & 1)
+            continue;
+        memcpy(&sample, &segment_->sample, sizeof(sample));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (segment_->seq.load(std::memory_order_relaxed) == before)
+        {
+            if (seq)
+                *seq = before;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t
+state_shm_reader::sequence() const
+{
+    if (segment_ == NULL)
+        return 0;
+    return segment_->seq.load(std::memory_order_acquire) & ~1u;
+}
+
+bool
+state_shm_reader::writerAlive() const
+{
+    return segment_ != NULL && segment_->alive.load(std::memory_order_acquire) != 0;
+}
+}
@@ -0,0 +1,122 @@
+#include <thermal_model.h>
+
+#include <math.h>
+
+namespace inspire_hand
+{
+
+constexpr double thermal_model::SCALE_STEP;
+constexpr double thermal_model::CURRENT_AVERAGE;
+constexpr double thermal_model::RAISE_HOLD;
+
+thermal_model::thermal_model():
+    ambient_(25),
+    horizon_(60),
+    min_scale_(0.3),
+    correction_(0.3)
+{
+    for (int i = 0; i < DOF; i++)
+        setActuator(i, 20, 120, 70);
+    reset();
+}
+
+void
+thermal_model::setActuator(int dof, double gain, double tau, double limit)
+{
+    if (dof < 0 || dof >= DOF)
+        return;
+    gain_[dof] = gain > 0 ? gain : 0;
+    tau_[dof] = tau > 1e-3 ? tau : 1e-3;
+    limit_[dof] = limit;
+}
+
+void
+thermal_model::setThrottle(double horizon, double min_scale)
+{
+    horizon_ = horizon > 0 ? horizon : 0;
+    min_scale_ = min_scale < 0 ? 0 : (min_scale > 1 ? 1 : min_scale);
+}
+
+void
+thermal_model::reset()
+{
+    initialized_ = false;
+    for (int i = 0; i < DOF; i++)
+    {
+        temp_[i] = ambient_;
+        amps_sq_avg_[i] = 0;
+        since_change_[i] = 0;
+        time_to_limit_[i] = -1;
+        scale_[i] = 1;
+    }
+}
+
+uint8_t
+thermal_model::update(double dt, const float *current, const float *temp)
+{
+    //The first reading is taken as it is, the actuators may already be warm
+    if (!initialized_ && temp)
+    {
+        for (int i = 0; i < DOF; i++)
+            temp_[i] = temp[i];
+        initialized_ = true;
+    }
+
+    uint8_t changed = 0;
+    double blend = 1 - exp(-dt / CURRENT_AVERAGE);
+    for (int i = 0; i < DOF; i++)
+    {
+        double amps = current[i] * 1e-3;
+        double heating = ambient_ + gain_[i] * amps * amps;
+        temp_[i] = heating + (temp_[i] - heating) * exp(-dt / tau_[i]);
+        if (temp)
+            temp_[i] += correction_ * (temp[i] - temp_[i]);
+
+        amps_sq_avg_[i] += blend * (amps * amps - amps_sq_avg_[i]);
+        double steady = ambient_ + gain_[i] * amps_sq_avg_[i];
+
+        //T(t) = steady + (T0 - steady) * exp(-t / tau), solved for T(t) = limit
+        if (temp_[i] >= limit_[i])
+            time_to_limit_[i] = 0;
+        else if (steady <= limit_[i])
+            time_to_limit_[i] = -1;
+        else
+            time_to_limit_[i] = -tau_[i] * log((steady - limit_[i]) / (steady - temp_[i]));
+
+        double target = 1;
+        if (time_to_limit_[i] >= 0 && time_to_limit_[i] < horizon_)
+            target = time_to_limit_[i] / horizon_;
+        if (target < min_scale_)
+            target = min_scale_;
+        target = floor(target / SCALE_STEP + 0.5) * SCALE_STEP;
+
+        //Down at once; up one step at a time after a hold, so the throttle
+        //does not flip between two neighbouring scales
+        since_change_[i] += dt;
+        double next = scale_[i];
+        if (target < scale_[i])
+            next = target;
+        else if (target > scale_[i] && since_change_[i] >= RAISE_HOLD)
+            next = scale_[i] + SCALE_STEP;
+        if (fabs(next - scale_[i]) > 1e-9)
+        {
+            scale_[i] = next > 1 ? 1 : next;
+            since_change_[i] = 0;
+            changed |= (1 << i);
+        }
+    }
+    return changed;
+}
+
+uint8_t
+thermal_model::throttled() const
+{
+    uint8_t mask = 0;
+    for (int i = 0; i < DOF; i++)
+    {
+        if (scale_[i] < 1)
+            mask |= (1 << i);
+    }
+    return mask;
+}
+}
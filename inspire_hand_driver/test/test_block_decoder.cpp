@@ -0,0 +1,123 @@
+#include <block_decoder.h>
+
+#include <gtest/gtest.h>
+#include <string.h>
+#include <vector>
+
+using inspire_hand::block_decoder;
+
+//count blocks at stride, buffer cut right after the last one; offset shifts the first block off alignment
+static std::vector<uint8_t>
+makeBlocks(size_t stride, size_t count, size_t offset, uint32_t seed)
+{
+    std::vector<uint8_t> data(offset + (count > 0 ? (count - 1) * stride + block_decoder::BLOCK_BYTES : 1), 0xa5);
+    uint32_t v = seed;
+    for (size_t k = 0; k < count; k++)
+        for (size_t b = 0; b < block_decoder::BLOCK_BYTES; b++)
+        {
+            //xorshift, so every bit pattern of both bytes turns up
+            v ^= v << 13;
+            v ^= v >> 17;
+            v ^= v << 5;
+            data[offset + k * stride + b] = v & 0xff;
+        }
+    return data;
+}
+
+struct decoded
+{
+    explicit decoded(size_t count)
+    {
+        for (int i = 0; i < block_decoder::DOF; i++)
+        {
+            //One guard value past the end catches a store beyond count
+            columns[i].assign(count + 1, -12345.0f);
+            out[i] = &columns[i][0];
+        }
+    }
+
+    std::vector<float> columns[block_decoder::DOF];
+    float *out[block_decoder::DOF];
+};
+
+TEST(BlockDecoder, ScalarSignExtension)
+{
+    //0x7fff, 0x8000, 0xffff, 0x0000, 0x0001, 0x1234 little endian
+    const uint8_t block[block_decoder::BLOCK_BYTES] = { 0xff, 0x7f, 0x00, 0x80, 0xff, 0xff,
+                                                        0x00, 0x00, 0x01, 0x00, 0x34, 0x12 };
+    decoded s(1);
+    block_decoder::decodeScalar(block, block_decoder::BLOCK_BYTES, 0, 1, true, s.out);
+    EXPECT_EQ(32767.0f, s.out[0][0]);
+    EXPECT_EQ(-32768.0f, s.out[1][0]);
+    EXPECT_EQ(-1.0f, s.out[2][0]);
+    EXPECT_EQ(0.0f, s.out[3][0]);
+    EXPECT_EQ(1.0f, s.out[4][0]);
+    EXPECT_EQ(4660.0f, s.out[5][0]);
+
+    decoded u(1);
+    block_decoder::decodeScalar(block, block_decoder::BLOCK_BYTES, 0, 1, false, u.out);
+    EXPECT_EQ(32767.0f, u.out[0][0]);
+    EXPECT_EQ(32768.0f, u.out[1][0]);
+    EXPECT_EQ(65535.0f, u.out[2][0]);
+    EXPECT_EQ(4660.0f, u.out[5][0]);
+}
+
+//Every path the CPU supports against the scalar reference: strides below and above the 16 byte
+//vector load, frame stride, counts around the 4 and 8 block groups and unaligned starts
+TEST(BlockDecoder, PathsMatchScalar)
+{
+    const size_t strides[] = { 12, 13, 14, 16, 19, 20, 24, 33 };
+    const size_t counts[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 11, 12, 15, 16, 17, 23, 24, 25, 31, 32, 33, 100, 1001 };
+    const size_t offsets[] = { 0, 1, 3 };
+    for (size_t s = 0; s < sizeof(strides) / sizeof(strides[0]); s++)
+        for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+            for (size_t o = 0; o < sizeof(offsets) / sizeof(offsets[0]); o++)
+                for (int sign = 0; sign < 2; sign++)
+                {
+                    size_t stride = strides[s];
+                    size_t count = counts[c];
+                    std::vector<uint8_t> data = makeBlocks(stride, count, offsets[o], 2463534242u + s * 31 + c);
+                    const uint8_t *first = &data[offsets[o]];
+
+                    decoded ref(count);
+                    block_decoder::decodeScalar(first, stride, 0, count, sign, ref.out);
+                    for (int p = block_decoder::PATH_SCALAR; p <= block_decoder::bestPath(); p++)
+                    {
+                        decoded got(count);
+                        block_decoder::decode(first, stride, count, sign, got.out, block_decoder::path(p));
+                        for (int i = 0; i < block_decoder::DOF; i++)
+                            ASSERT_EQ(0, memcmp(&ref.columns[i][0], &got.columns[i][0], (count + 1) * sizeof(float)))
+                                << block_decoder::pathName(block_decoder::path(p)) << " stride " << stride
+                                << " count " << count << " offset " << offsets[o] << (sign ? " signed" : " unsigned")
+                                << " dof " << i;
+                    }
+                }
+}
+
+//Frames as the capture tool walks them: the bytes between blocks must not leak into any DOF
+TEST(BlockDecoder, IgnoresBytesBetweenBlocks)
+{
+    const size_t stride = 20;
+    const size_t count = 37;
+    std::vector<uint8_t> data = makeBlocks(stride, count, 0, 88172645u);
+    std::vector<uint8_t> noisy = data;
+    for (size_t k = 0; k + 1 < count; k++)
+        for (size_t b = block_decoder::BLOCK_BYTES; b < stride; b++)
+            noisy[k * stride + b] ^= 0xff;
+    for (int p = block_decoder::PATH_SCALAR; p <= block_decoder::bestPath(); p++)
+    {
+        decoded a(count);
+        decoded b(count);
+        block_decoder::decode(&data[0], stride, count, true, a.out, block_decoder::path(p));
+        block_decoder::decode(&noisy[0], stride, count, true, b.out, block_decoder::path(p));
+        for (int i = 0; i < block_decoder::DOF; i++)
+            EXPECT_EQ(a.columns[i], b.columns[i]) << block_decoder::pathName(block_decoder::path(p)) << " dof " << i;
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}